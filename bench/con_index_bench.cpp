@@ -0,0 +1,127 @@
+/*
+ * Compare ConIndex against std::unordered_map for building a con_id / X window index
+ * of a large tree and for lookups in it.
+ *
+ * Usage: con_index_bench [windows] [lookups]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+
+#include "con_index.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+/**
+ * Build root -> outputs -> workspaces -> split containers -> windows.  Ids look like
+ * heap addresses, as they do in i3.
+ */
+static shared_ptr<i3ipc::container_t> makeTree(size_t windows, vector<uint64_t> &windowIds) {
+    uint64_t nextId = 0x55d4a0000000ULL;
+    auto make = [&nextId](const char *type) {
+        auto c = make_shared<i3ipc::container_t>();
+        c->id = nextId;
+        c->xwindow_id = 0;
+        c->type = type;
+        nextId += 0x1a0;
+        return c;
+    };
+
+    auto root = make("root");
+    size_t made = 0;
+    uint64_t xwindow = 0x1400001;
+
+    for (int o = 0; o < 4 && made < windows; o++) {
+        auto output = make("output");
+        root->nodes.push_back(output);
+
+        for (int w = 0; w < 25 && made < windows; w++) {
+            auto workspace = make("workspace");
+            output->nodes.push_back(workspace);
+
+            size_t perWorkspace = windows / 100 + 1;
+            for (size_t s = 0; s < perWorkspace && made < windows; s += 8) {
+                auto split = make("con");
+                workspace->nodes.push_back(split);
+
+                for (size_t i = 0; i < 8 && made < windows; i++, made++) {
+                    auto window = make("con");
+                    window->xwindow_id = xwindow++;
+                    windowIds.push_back(window->id);
+                    split->nodes.push_back(window);
+                }
+            }
+        }
+    }
+
+    return root;
+}
+
+static void indexTree(const i3ipc::container_t &c, unordered_map<uint64_t, const i3ipc::container_t *> &byId,
+                      unordered_map<uint64_t, const i3ipc::container_t *> &byXWindow) {
+    byId.emplace(c.id, &c);
+    if (c.xwindow_id != 0) byXWindow.emplace(c.xwindow_id, &c);
+
+    for (auto &node : c.nodes) indexTree(*node, byId, byXWindow);
+    for (auto &node : c.floating_nodes) indexTree(*node, byId, byXWindow);
+}
+
+static double elapsedMs(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    size_t windows = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+    size_t lookups = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1000000;
+
+    vector<uint64_t> windowIds;
+    auto root = makeTree(windows, windowIds);
+
+    mt19937_64 random(42);
+    vector<uint64_t> probes(lookups);
+    for (auto &probe : probes) probe = windowIds[random() % windowIds.size()];
+
+    // Best of several builds, so both see a warm tree and reused allocations.
+    const int rounds = 5;
+    double flatBuild = 1e9, mapBuild = 1e9;
+    size_t containers = 0;
+
+    for (int round = 0; round < rounds; round++) {
+        auto start = Clock::now();
+        ConIndex built(*root);
+        flatBuild = min(flatBuild, elapsedMs(start));
+        containers = built.all().size();
+    }
+
+    for (int round = 0; round < rounds; round++) {
+        auto start = Clock::now();
+        unordered_map<uint64_t, const i3ipc::container_t *> builtById, builtByXWindow;
+        indexTree(*root, builtById, builtByXWindow);
+        mapBuild = min(mapBuild, elapsedMs(start));
+    }
+
+    ConIndex index(*root);
+    unordered_map<uint64_t, const i3ipc::container_t *> byId, byXWindow;
+    indexTree(*root, byId, byXWindow);
+
+    uint64_t checksum = 0;
+    auto start = Clock::now();
+    for (auto probe : probes) checksum += index.find(probe)->xwindowId;
+    double flatLookup = elapsedMs(start);
+
+    start = Clock::now();
+    for (auto probe : probes) checksum -= byId.find(probe)->second->xwindow_id;
+    double mapLookup = elapsedMs(start);
+
+    printf("%zu containers, %zu windows, %zu lookups (checksum %llu)\n", containers, windowIds.size(),
+           lookups, static_cast<unsigned long long>(checksum));
+    printf("%-20s %12s %14s\n", "", "build ms", "lookup ns/op");
+    printf("%-20s %12.2f %14.1f\n", "ConIndex", flatBuild, flatLookup * 1e6 / lookups);
+    printf("%-20s %12.2f %14.1f\n", "std::unordered_map", mapBuild, mapLookup * 1e6 / lookups);
+
+    return checksum == 0 ? 0 : 1;
+}
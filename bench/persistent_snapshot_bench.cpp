@@ -0,0 +1,98 @@
+/*
+ * Save consecutive captures of a large tree under separate names in a SnapshotStore, as
+ * the service does, and as plain Snapshot copies, comparing time and memory allocated
+ * per capture.
+ *
+ * Usage: persistent_snapshot_bench [windows] [captures] [changes per capture]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+#include "persistent_snapshot.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static size_t allocatedBytes = 0;
+
+void *operator new(size_t size) {
+    allocatedBytes += size;
+    void *memory = malloc(size);
+    if (memory == nullptr) throw bad_alloc();
+    return memory;
+}
+
+void operator delete(void *memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    free(memory);
+}
+
+static double elapsedMs(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    size_t windows = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+    size_t captures = argc > 2 ? strtoul(argv[2], nullptr, 10) : 100;
+    size_t changes = argc > 3 ? strtoul(argv[3], nullptr, 10) : 10;
+
+    mt19937_64 random(42);
+    Snapshot live;
+    for (size_t i = 0; i < windows; i++) {
+        WindowRecord record;
+        record.outputName = i % 2 == 0 ? "eDP-1" : "HDMI-1";
+        record.workspaceId = 0x55d4a0000000ULL + (i % 50) * 0x1a0;
+        record.workspaceName = to_string(i % 50 + 1);
+        record.windowId = 0x55d4b0000000ULL + i * 0x1a0;
+        record.windowName = "window title number " + to_string(i);
+        live.push_back(record);
+    }
+
+    SnapshotStore store;
+    size_t rounds = captures > 1 ? captures - 1 : 1;
+    vector<Snapshot> copies;
+    double firstMs = 0, persistentMs = 0, copyMs = 0;
+    size_t persistentBytes = 0, copyBytes = 0;
+
+    for (size_t capture = 0; capture < captures; capture++) {
+        if (capture > 0) {
+            for (size_t i = 0; i < changes; i++) {
+                WindowRecord &record = live[random() % live.size()];
+                size_t workspace = random() % 50;
+                record.workspaceId = 0x55d4a0000000ULL + workspace * 0x1a0;
+                record.workspaceName = to_string(workspace + 1);
+            }
+        }
+
+        size_t before = allocatedBytes;
+        auto start = Clock::now();
+        store.save("capture " + to_string(capture), live);
+        if (capture > 0) persistentMs += elapsedMs(start);
+        else firstMs = elapsedMs(start);
+        if (capture > 0) persistentBytes += allocatedBytes - before;
+
+        before = allocatedBytes;
+        start = Clock::now();
+        copies.push_back(live);
+        if (capture > 0) copyMs += elapsedMs(start);
+        if (capture > 0) copyBytes += allocatedBytes - before;
+    }
+
+    const PersistentSnapshot *last = store.load("capture " + to_string(captures - 1));
+    bool intact = last != nullptr && last->toSnapshot().size() == live.size();
+
+    printf("%zu windows, %zu captures, %zu changes each\n", windows, captures, changes);
+    printf("first PersistentSnapshot build: %.3f ms\n", firstMs);
+    printf("%-20s %14s %16s\n", "", "capture ms", "capture KiB");
+    printf("%-20s %14.3f %16.1f\n", "PersistentSnapshot", persistentMs / rounds, persistentBytes / 1024.0 / rounds);
+    printf("%-20s %14.3f %16.1f\n", "Snapshot copy", copyMs / rounds, copyBytes / 1024.0 / rounds);
+
+    return intact ? 0 : 1;
+}
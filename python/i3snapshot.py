@@ -0,0 +1,155 @@
+"""ctypes bindings for libi3snapshot.
+
+Capture, diff and restore i3 layouts in-process instead of running the
+i3-snapshot binary and decoding its output.
+
+    import i3snapshot
+    saved = i3snapshot.capture()
+    ...
+    moved = i3snapshot.diff(saved, i3snapshot.capture())
+    i3snapshot.restore(moved)
+"""
+
+import ctypes
+import ctypes.util
+from collections import namedtuple
+
+ABI_VERSION = 2
+
+MATCH_TITLE = 1 << 0
+CONTINUE = 1 << 1
+DRYRUN = 1 << 2
+RAW_STRINGS = 1 << 3
+
+PLACEMENT_TILING = 0
+PLACEMENT_FLOATING = 1
+PLACEMENT_SCRATCHPAD = 2
+
+Window = namedtuple("Window", "output_name workspace_name workspace_id window_id window_name placement mark")
+
+
+class _Window(ctypes.Structure):
+    _fields_ = [
+        ("output_name", ctypes.c_char_p),
+        ("workspace_name", ctypes.c_char_p),
+        ("workspace_id", ctypes.c_uint64),
+        ("window_id", ctypes.c_uint64),
+        ("window_name", ctypes.c_char_p),
+        ("placement", ctypes.c_int),
+        ("mark", ctypes.c_char_p),
+    ]
+
+
+def _load():
+    lib = ctypes.CDLL(ctypes.util.find_library("i3snapshot") or "libi3snapshot.so")
+
+    lib.i3snap_abi_version.restype = ctypes.c_int
+    lib.i3snap_capture.argtypes = [ctypes.c_char_p]
+    lib.i3snap_capture.restype = ctypes.c_void_p
+    lib.i3snap_parse.argtypes = [ctypes.c_char_p, ctypes.c_size_t]
+    lib.i3snap_parse.restype = ctypes.c_void_p
+    lib.i3snap_format.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.i3snap_format.restype = ctypes.c_void_p
+    lib.i3snap_string_free.argtypes = [ctypes.c_void_p]
+    lib.i3snap_size.argtypes = [ctypes.c_void_p]
+    lib.i3snap_size.restype = ctypes.c_size_t
+    lib.i3snap_get.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+    lib.i3snap_get.restype = ctypes.POINTER(_Window)
+    lib.i3snap_diff.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+    lib.i3snap_diff.restype = ctypes.c_void_p
+    lib.i3snap_restore.argtypes = [ctypes.c_char_p, ctypes.c_void_p, ctypes.c_int]
+    lib.i3snap_restore.restype = ctypes.c_int
+    lib.i3snap_free.argtypes = [ctypes.c_void_p]
+    lib.i3snap_last_error.restype = ctypes.c_char_p
+
+    if lib.i3snap_abi_version() < ABI_VERSION:
+        raise ImportError("libi3snapshot ABI version mismatch")
+    return lib
+
+
+_lib = _load()
+
+
+class Error(Exception):
+    pass
+
+
+def _check(handle):
+    if not handle:
+        message = _lib.i3snap_last_error()
+        raise Error(message.decode("utf-8", "replace") if message else "unknown error")
+    return handle
+
+
+def _encode(value):
+    return value.encode("utf-8") if value is not None else None
+
+
+class Snapshot:
+    """Owns a native snapshot handle; iterating yields Window tuples."""
+
+    def __init__(self, handle):
+        self._handle = _check(handle)
+
+    def __del__(self, _free=_lib.i3snap_free):
+        if getattr(self, "_handle", None):
+            _free(self._handle)
+            self._handle = None
+
+    def __len__(self):
+        return _lib.i3snap_size(self._handle)
+
+    def __getitem__(self, index):
+        if index < 0:
+            index += len(self)
+        record = _lib.i3snap_get(self._handle, index)
+        if not record:
+            raise IndexError(index)
+        record = record.contents
+        return Window(record.output_name.decode("utf-8", "replace"),
+                      record.workspace_name.decode("utf-8", "replace"),
+                      record.workspace_id,
+                      record.window_id,
+                      record.window_name.decode("utf-8", "replace"),
+                      record.placement,
+                      record.mark.decode("utf-8", "replace"))
+
+    def __iter__(self):
+        for index in range(len(self)):
+            yield self[index]
+
+    def format(self, flags=0):
+        text = _lib.i3snap_format(self._handle, flags)
+        try:
+            return ctypes.string_at(text).decode("utf-8")
+        finally:
+            _lib.i3snap_string_free(text)
+
+
+def capture(socket_path=None):
+    return Snapshot(_lib.i3snap_capture(_encode(socket_path)))
+
+
+def parse(text):
+    data = text.encode("utf-8") if isinstance(text, str) else text
+    return Snapshot(_lib.i3snap_parse(data, len(data)))
+
+
+def diff(saved, live):
+    return Snapshot(_lib.i3snap_diff(saved._handle, live._handle))
+
+
+def restore(snapshot, flags=0, socket_path=None):
+    """Return the number of windows that failed to move.
+
+    The reasons are not printed; they are in last_error() until the next failing call.
+    """
+    failed = _lib.i3snap_restore(_encode(socket_path), snapshot._handle, flags)
+    if failed < 0:
+        _check(None)
+    return failed
+
+
+def last_error():
+    message = _lib.i3snap_last_error()
+    return message.decode("utf-8", "replace") if message else None
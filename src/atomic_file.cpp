@@ -0,0 +1,177 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "atomic_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static runtime_error fileError(const string &what, const string &path, int error) {
+    return runtime_error("Unable to " + what + " " + path + ": " + strerror(error));
+}
+
+static string directoryOf(const string &path) {
+    size_t slash = path.rfind('/');
+    if (slash == string::npos) return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+/**
+ * @return permissions of a newly created file, as open() would apply them.
+ */
+static mode_t newFileMode() {
+    mode_t mask = umask(0);
+    umask(mask);
+    return 0666 & ~mask;
+}
+
+static void writeAll(int fd, const string &contents, const string &path) {
+    const char *data = contents.data();
+    size_t left = contents.size();
+
+    // One write() for the whole snapshot; the loop only continues after a short write.
+    while (left > 0) {
+        ssize_t written = write(fd, data, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw fileError("write", path, errno);
+        }
+        data += written;
+        left -= static_cast<size_t>(written);
+    }
+}
+
+static void syncDirectory(const string &directory) {
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) throw fileError("open", directory, errno);
+
+    int result = fsync(fd);
+    int error = errno;
+    close(fd);
+    if (result != 0) throw fileError("sync", directory, error);
+}
+
+/**
+ * @return a name next to path that is unlikely to exist.
+ */
+static string temporaryName(const string &path) {
+    static mt19937 random{random_device{}()};
+    return path + ".tmp" + to_string(random());
+}
+
+/**
+ * Write into an unnamed file and give it a name only once it is complete.
+ * @return false if the file system does not support O_TMPFILE.
+ */
+static bool writeWithTmpfile(const string &path, const string &directory, const string &contents, bool durable) {
+#ifdef O_TMPFILE
+    int fd = open(directory.c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, newFileMode());
+    if (fd < 0) {
+        if (errno == EOPNOTSUPP || errno == EISDIR || errno == EINVAL) return false;
+        throw fileError("create a file in", directory, errno);
+    }
+
+    string linked;
+    bool noProc = false;
+    try {
+        writeAll(fd, contents, path);
+        if (durable && fsync(fd) != 0) throw fileError("sync", path, errno);
+
+        // linkat() cannot replace an existing file: link under a temporary name, then rename.
+        char procPath[64];
+        snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", fd);
+        for (int attempt = 0; linked.empty(); attempt++) {
+            string name = temporaryName(path);
+            if (linkat(AT_FDCWD, procPath, AT_FDCWD, name.c_str(), AT_SYMLINK_FOLLOW) == 0) {
+                linked = name;
+            } else if (errno == ENOENT) {
+                // No /proc to name the file by.
+                noProc = true;
+                break;
+            } else if (errno != EEXIST || attempt >= 8) {
+                throw fileError("link", name, errno);
+            }
+        }
+        if (noProc) {
+            close(fd);
+            return false;
+        }
+
+        if (rename(linked.c_str(), path.c_str()) != 0) throw fileError("rename to", path, errno);
+    } catch (...) {
+        if (!linked.empty()) unlink(linked.c_str());
+        close(fd);
+        throw;
+    }
+
+    close(fd);
+    return true;
+#else
+    (void) path;
+    (void) directory;
+    (void) contents;
+    (void) durable;
+    return false;
+#endif
+}
+
+static void writeWithTempName(const string &path, const string &contents, bool durable) {
+    string name = path + ".XXXXXX";
+    int fd = mkostemp(&name[0], O_CLOEXEC);
+    if (fd < 0) throw fileError("create", name, errno);
+
+    try {
+        if (fchmod(fd, newFileMode()) != 0) throw fileError("set mode of", name, errno);
+        writeAll(fd, contents, path);
+        if (durable && fsync(fd) != 0) throw fileError("sync", path, errno);
+        if (rename(name.c_str(), path.c_str()) != 0) throw fileError("rename to", path, errno);
+    } catch (...) {
+        unlink(name.c_str());
+        close(fd);
+        throw;
+    }
+
+    close(fd);
+}
+
+void writeFileAtomically(const string &path, const string &contents, bool durable) {
+    string directory = directoryOf(path);
+
+    if (!writeWithTmpfile(path, directory, contents, durable)) writeWithTempName(path, contents, durable);
+
+    if (durable) syncDirectory(directory);
+}
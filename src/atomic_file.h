@@ -0,0 +1,52 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_ATOMIC_FILE_H
+#define I3_SNAPSHOT_ATOMIC_FILE_H
+
+#include <string>
+
+/**
+ * Replace a file with new contents such that readers see either the old file or the
+ * complete new one, never a truncated or partial file.
+ *
+ * The contents are written with a single write() into an unnamed O_TMPFILE in the
+ * target's directory, or a mkstemp() file where O_TMPFILE is not supported, and then
+ * renamed over the target.
+ *
+ * @param path file to replace
+ * @param contents complete new contents
+ * @param durable fsync the file and its directory so the new contents survive a crash;
+ * not needed for files on tmpfs.
+ * @throws std::runtime_error if the file cannot be written, leaving the target untouched.
+ */
+void writeFileAtomically(const std::string &path, const std::string &contents, bool durable);
+
+#endif //I3_SNAPSHOT_ATOMIC_FILE_H
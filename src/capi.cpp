@@ -0,0 +1,160 @@
+/*
+ * i3-snapshot C API, see i3snapshot.h.
+ */
+
+#include "i3snapshot.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+
+#include "plan.h"
+#include "snapshot.h"
+
+using namespace std;
+
+struct i3snap_snapshot {
+    Snapshot records;
+    vector<i3snap_window> views;
+};
+
+static_assert(PLACEMENT_TILING == I3SNAP_PLACEMENT_TILING && PLACEMENT_FLOATING == I3SNAP_PLACEMENT_FLOATING
+              && PLACEMENT_SCRATCHPAD == I3SNAP_PLACEMENT_SCRATCHPAD, "placement values are part of the C ABI");
+
+static thread_local string lastError;
+
+/**
+ * Wrap records into a handle, building the C views over their strings.
+ */
+static i3snap_snapshot *makeHandle(Snapshot &&records) {
+    auto handle = new i3snap_snapshot;
+    handle->records = move(records);
+    handle->views.reserve(handle->records.size());
+
+    for (auto &record : handle->records) {
+        i3snap_window view{};
+        view.output_name = record.outputName.c_str();
+        view.workspace_name = record.workspaceName.c_str();
+        view.workspace_id = record.workspaceId;
+        view.window_id = record.windowId;
+        view.window_name = record.windowName.c_str();
+        view.placement = record.placement;
+        view.mark = record.mark.c_str();
+        handle->views.push_back(view);
+    }
+
+    return handle;
+}
+
+static CommandLineOptions optionsFromFlags(int flags, const char *socketPath = nullptr) {
+    CommandLineOptions opts = defaultOptions();
+
+    if (socketPath != nullptr) opts.socketPath = socketPath;
+    if (flags & I3SNAP_MATCH_TITLE) opts.windowIdentifier = WINDOW_TITLE;
+    if (flags & I3SNAP_CONTINUE) opts.failFast = false;
+    if (flags & I3SNAP_DRYRUN) opts.dryRun = true;
+    if (flags & I3SNAP_RAW_STRINGS) opts.encodeStrings = false;
+
+    return opts;
+}
+
+static unique_ptr<i3ipc::connection> connect(const char *socketPath) {
+    if (socketPath == nullptr) return unique_ptr<i3ipc::connection>(new i3ipc::connection());
+
+    return unique_ptr<i3ipc::connection>(new i3ipc::connection(socketPath));
+}
+
+extern "C" {
+
+int i3snap_abi_version(void) {
+    return I3SNAP_ABI_VERSION;
+}
+
+i3snap_snapshot *i3snap_capture(const char *socket_path) {
+    try {
+        auto i3conn = connect(socket_path);
+        return makeHandle(captureSnapshot(*i3conn));
+    } catch (const exception &e) {
+        lastError = e.what();
+        return nullptr;
+    }
+}
+
+i3snap_snapshot *i3snap_parse(const char *data, size_t length) {
+    try {
+        istringstream in(string(data, length));
+        return makeHandle(readSnapshot(in));
+    } catch (const exception &e) {
+        lastError = e.what();
+        return nullptr;
+    }
+}
+
+char *i3snap_format(const i3snap_snapshot *snapshot, int flags) {
+    if (snapshot == nullptr) return nullptr;
+
+    ostringstream out;
+    writeSnapshot(out, snapshot->records, optionsFromFlags(flags).encodeStrings);
+    return strdup(out.str().c_str());
+}
+
+void i3snap_string_free(char *text) {
+    free(text);
+}
+
+size_t i3snap_size(const i3snap_snapshot *snapshot) {
+    return snapshot == nullptr ? 0 : snapshot->views.size();
+}
+
+const i3snap_window *i3snap_get(const i3snap_snapshot *snapshot, size_t index) {
+    if (snapshot == nullptr || index >= snapshot->views.size()) return nullptr;
+
+    return &snapshot->views[index];
+}
+
+i3snap_snapshot *i3snap_diff(const i3snap_snapshot *saved, const i3snap_snapshot *live) {
+    if (saved == nullptr || live == nullptr) {
+        lastError = "snapshot is NULL";
+        return nullptr;
+    }
+
+    return makeHandle(diffSnapshots(saved->records, live->records));
+}
+
+int i3snap_restore(const char *socket_path, const i3snap_snapshot *snapshot, int flags) {
+    if (snapshot == nullptr) {
+        lastError = "snapshot is NULL";
+        return -1;
+    }
+
+    // Collect the failures of the restore rather than printing into the caller's stderr.
+    string failures;
+    onRestoreFailure([&failures](const string &message) {
+        if (!failures.empty()) failures += "\n";
+        failures += message;
+    });
+
+    int failed;
+    try {
+        auto i3conn = connect(socket_path);
+        failed = static_cast<int>(restoreSnapshot(*i3conn, snapshot->records, optionsFromFlags(flags, socket_path)));
+    } catch (const exception &e) {
+        failures = e.what();
+        failed = -1;
+    }
+    onRestoreFailure(nullptr);
+
+    if (failed != 0) lastError = failures;
+    return failed;
+}
+
+void i3snap_free(i3snap_snapshot *snapshot) {
+    delete snapshot;
+}
+
+const char *i3snap_last_error(void) {
+    return lastError.empty() ? nullptr : lastError.c_str();
+}
+
+}
@@ -0,0 +1,61 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "con_index.h"
+
+using namespace std;
+
+ConIndex::ConIndex(const i3ipc::container_t &root) {
+    add(root, ConRecord::NONE, ConRecord::NONE, ConRecord::NONE, 0, false);
+
+    // Hash from the compact records rather than during the traversal: the tables are
+    // sized exactly once and the pointer chasing through the tree stays a single pass.
+    byId.reserve(records.size());
+    byXWindow.reserve(records.size());
+    for (uint32_t position = 0; position < records.size(); position++) {
+        byId.insert(records[position].id, position);
+        byXWindow.insert(records[position].xwindowId, position);
+    }
+}
+
+void ConIndex::add(const i3ipc::container_t &c, uint32_t parent, uint32_t workspace, uint32_t output,
+                   uint16_t depth, bool floating) {
+    uint32_t position = static_cast<uint32_t>(records.size());
+
+    if (c.type == "output") output = position;
+    else if (c.type == "workspace") workspace = position;
+
+    records.push_back(ConRecord{c.id, c.xwindow_id, parent, workspace, output, depth, floating, &c});
+
+    for (auto &node : c.nodes)
+        add(*node, position, workspace, output, depth + 1, floating);
+    for (auto &node : c.floating_nodes)
+        add(*node, position, workspace, output, depth + 1, true);
+}
@@ -0,0 +1,181 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_CON_INDEX_H
+#define I3_SNAPSHOT_CON_INDEX_H
+
+#include <i3ipc++/ipc.hpp>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Flat open-addressing hash map from a non-zero 64 bit id to a 32 bit value, with linear
+ * probing over one array of key/value slots so a lookup touches a single cache line.
+ * Built once and then only read, so there is no deletion.
+ */
+class FlatIdMap {
+public:
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    explicit FlatIdMap(size_t expected = 0) { reserve(expected); }
+
+    /**
+     * Size the table for at least the given number of keys, at most half full.
+     */
+    void reserve(size_t expected) {
+        size_t capacity = 16;
+        while (capacity < expected * 2) capacity <<= 1;
+        if (capacity <= slots.size()) return;
+
+        std::vector<Slot> old(capacity, Slot{0, NOT_FOUND});
+        old.swap(slots);
+        mask = capacity - 1;
+        count = 0;
+
+        for (auto &slot : old)
+            if (slot.key != 0) insert(slot.key, slot.value);
+    }
+
+    /**
+     * Map key to value, replacing an earlier value.  Key 0 is ignored.
+     */
+    void insert(uint64_t key, uint32_t value) {
+        if (key == 0) return;
+        if ((count + 1) * 2 > slots.size()) reserve(count + 1);
+
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            Slot &slot = slots[i];
+            if (slot.key == key) {
+                slot.value = value;
+                return;
+            }
+            if (slot.key == 0) {
+                slot.key = key;
+                slot.value = value;
+                count++;
+                return;
+            }
+        }
+    }
+
+    /**
+     * @return value of key, or NOT_FOUND.
+     */
+    uint32_t find(uint64_t key) const {
+        if (key == 0 || slots.empty()) return NOT_FOUND;
+
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            const Slot &slot = slots[i];
+            if (slot.key == key) return slot.value;
+            if (slot.key == 0) return NOT_FOUND;
+        }
+    }
+
+    size_t size() const { return count; }
+
+    /**
+     * Bijective mix of an id, shared with other id keyed structures.
+     */
+    static uint64_t hash(uint64_t key) {
+        // i3 ids are heap addresses: mix the low bits well (splitmix64 finalizer).
+        key ^= key >> 30;
+        key *= 0xbf58476d1ce4e5b9ULL;
+        key ^= key >> 27;
+        key *= 0x94d049bb133111ebULL;
+        return key ^ (key >> 31);
+    }
+
+private:
+    struct Slot {
+        uint64_t key;
+        uint32_t value;
+    };
+
+    std::vector<Slot> slots;
+    size_t mask{};
+    size_t count{};
+};
+
+/**
+ * Compact copy of the facts about a container that lookups need.
+ */
+struct ConRecord {
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    uint64_t id;
+    uint64_t xwindowId;
+    uint32_t parent;
+    uint32_t workspace;
+    uint32_t output;
+    uint16_t depth;
+    bool floating;
+    const i3ipc::container_t *container;
+};
+
+/**
+ * Index of every container of a tree by con_id and by X window id, built in one traversal.
+ * Records refer to the tree, which must outlive the index.
+ */
+class ConIndex {
+public:
+    explicit ConIndex(const i3ipc::container_t &root);
+
+    /**
+     * @return the container with this con_id, or nullptr.
+     */
+    const ConRecord *find(uint64_t id) const { return at(byId.find(id)); }
+
+    /**
+     * @return the window with this X window id, or nullptr.
+     */
+    const ConRecord *findByXWindow(uint64_t xwindowId) const { return at(byXWindow.find(xwindowId)); }
+
+    /**
+     * @return the record at position, or nullptr for ConRecord::NONE.
+     */
+    const ConRecord *at(uint32_t position) const {
+        return position >= records.size() ? nullptr : &records[position];
+    }
+
+    /**
+     * All containers in depth-first order.
+     */
+    const std::vector<ConRecord> &all() const { return records; }
+
+private:
+    void add(const i3ipc::container_t &c, uint32_t parent, uint32_t workspace, uint32_t output, uint16_t depth,
+             bool floating);
+
+    std::vector<ConRecord> records;
+    FlatIdMap byId;
+    FlatIdMap byXWindow;
+};
+
+#endif //I3_SNAPSHOT_CON_INDEX_H
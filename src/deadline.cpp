@@ -0,0 +1,189 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "deadline.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "event_log.h"
+
+using namespace std;
+
+static DeadlineBudget budget{};
+static int watchedFd = -1;
+static uint64_t runDeadlineNs;
+static uint64_t phaseDeadlineNs;
+static uint64_t requestDeadlineNs;
+
+// Read by the watchdog signal handler.
+static atomic<const char *> currentPhase{"startup"};
+static atomic<size_t> progressDone{0};
+static atomic<size_t> progressTotal{0};
+
+static uint64_t deadlineAfter(int ms) {
+    return ms > 0 ? eventClockNs() + static_cast<uint64_t>(ms) * 1000000u : 0;
+}
+
+/**
+ * Append text or a number to a fixed buffer, usable from a signal handler.
+ */
+static void append(char *buffer, size_t &used, size_t size, const char *text) {
+    while (*text != '\0' && used < size) buffer[used++] = *text++;
+}
+
+static void append(char *buffer, size_t &used, size_t size, uint64_t value) {
+    char digits[24];
+    int count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (count > 0 && used < size) buffer[used++] = digits[--count];
+}
+
+void reportTimeout(const char *reason) {
+    char buffer[256];
+    size_t used = 0;
+
+    append(buffer, used, sizeof(buffer), "i3-snapshot: ");
+    append(buffer, used, sizeof(buffer), reason);
+    append(buffer, used, sizeof(buffer), " in phase '");
+    append(buffer, used, sizeof(buffer), currentPhase.load());
+    append(buffer, used, sizeof(buffer), "'");
+    if (progressTotal.load() > 0) {
+        append(buffer, used, sizeof(buffer), ", ");
+        append(buffer, used, sizeof(buffer), progressDone.load());
+        append(buffer, used, sizeof(buffer), " of ");
+        append(buffer, used, sizeof(buffer), progressTotal.load());
+        append(buffer, used, sizeof(buffer), " done");
+    }
+    append(buffer, used, sizeof(buffer), ".\n");
+
+    ssize_t ignored = write(STDERR_FILENO, buffer, used);
+    (void) ignored;
+}
+
+static void handleWatchdog(int) {
+    reportTimeout("run timed out");
+    dumpEventLog(STDERR_FILENO);
+    _exit(EXIT_TIMEOUT);
+}
+
+void startDeadlines(const DeadlineBudget &runBudget) {
+    budget = runBudget;
+    runDeadlineNs = deadlineAfter(budget.runMs);
+    phaseDeadlineNs = deadlineAfter(budget.phaseMs);
+
+    if (budget.runMs <= 0) return;
+
+    struct sigaction action{};
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = handleWatchdog;
+    sigaction(SIGALRM, &action, nullptr);
+
+    itimerval timer{};
+    timer.it_value.tv_sec = budget.runMs / 1000;
+    timer.it_value.tv_usec = (budget.runMs % 1000) * 1000;
+    setitimer(ITIMER_REAL, &timer, nullptr);
+}
+
+void boundSession(int ms) {
+    runDeadlineNs = deadlineAfter(ms);
+}
+
+void watchSocket(int socketFd) {
+    watchedFd = socketFd;
+}
+
+void beginPhase(const char *phase) {
+    currentPhase = phase;
+    progressDone = 0;
+    progressTotal = 0;
+    phaseDeadlineNs = deadlineAfter(budget.phaseMs);
+}
+
+void reportProgress(size_t done, size_t total) {
+    progressDone = done;
+    progressTotal = total;
+}
+
+void armRequest() {
+    uint64_t deadline = deadlineAfter(budget.requestMs);
+    for (uint64_t bound : {runDeadlineNs, phaseDeadlineNs})
+        if (bound != 0 && (deadline == 0 || bound < deadline)) deadline = bound;
+
+    requestDeadlineNs = deadline;
+    if (watchedFd >= 0) armSocket(watchedFd, deadline);
+}
+
+uint64_t requestDeadline() {
+    return requestDeadlineNs;
+}
+
+void armSocket(int socketFd, uint64_t deadlineNs) {
+    if (deadlineNs == 0) return;
+
+    uint64_t now = eventClockNs();
+    if (deadlineNs <= now)
+        throw DeadlineExceeded(string("no time left in phase '") + currentPhase.load() + "'");
+
+    uint64_t remainingUs = (deadlineNs - now) / 1000;
+    timeval timeout{};
+    timeout.tv_sec = static_cast<time_t>(remainingUs / 1000000);
+    timeout.tv_usec = static_cast<suseconds_t>(remainingUs % 1000000);
+    if (timeout.tv_sec == 0 && timeout.tv_usec == 0) timeout.tv_usec = 1;
+
+    setsockopt(socketFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(socketFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+bool requestTimedOut() {
+    // Socket timeouts are rounded to the kernel tick, allow for firing slightly early.
+    return requestDeadlineNs != 0 && eventClockNs() + 1000000u >= requestDeadlineNs;
+}
+
+void stopDeadlines() {
+    itimerval timer{};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+
+    if (watchedFd >= 0) {
+        timeval none{};
+        setsockopt(watchedFd, SOL_SOCKET, SO_RCVTIMEO, &none, sizeof(none));
+        setsockopt(watchedFd, SOL_SOCKET, SO_SNDTIMEO, &none, sizeof(none));
+    }
+
+    watchedFd = -1;
+    runDeadlineNs = phaseDeadlineNs = requestDeadlineNs = 0;
+}
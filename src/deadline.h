@@ -0,0 +1,126 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_DEADLINE_H
+#define I3_SNAPSHOT_DEADLINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Exit code of a run that ran out of time, as used by timeout(1).
+ */
+const int EXIT_TIMEOUT = 124;
+
+const int DEFAULT_RUN_TIMEOUT_MS = 30000;
+const int DEFAULT_REQUEST_TIMEOUT_MS = 5000;
+
+/**
+ * Time limits of a run in milliseconds, 0 meaning unlimited.
+ */
+struct DeadlineBudget {
+    int runMs;
+    int phaseMs;
+    int requestMs;
+};
+
+class DeadlineExceeded : public std::runtime_error {
+public:
+    explicit DeadlineExceeded(const std::string &what) : std::runtime_error(what) {}
+};
+
+/**
+ * Start the run clock.  A watchdog ends the process with EXIT_TIMEOUT and a progress
+ * report once the run budget is spent, even while blocked in connect or IPC.
+ */
+void startDeadlines(const DeadlineBudget &budget);
+
+/**
+ * Bound all requests until stopDeadlines() to ms from now, as the run budget does but
+ * without the watchdog ending the process.  Lets a long-running process give up on one
+ * slow i3 session and carry on.
+ */
+void boundSession(int ms);
+
+/**
+ * Bound every following request on this socket, see armRequest().
+ */
+void watchSocket(int socketFd);
+
+/**
+ * Start a named phase with a fresh phase budget and reset progress.
+ */
+void beginPhase(const char *phase);
+
+/**
+ * Record how much of the current phase is done, for the timeout report.
+ */
+void reportProgress(size_t done, size_t total);
+
+/**
+ * Prepare the watched socket for one request: its send and receive timeouts become the
+ * smallest of the request timeout and what is left of the phase and run budgets.
+ * @throws DeadlineExceeded if no time is left.
+ */
+void armRequest();
+
+/**
+ * @return when the request armed last must be done, in eventClockNs() time, or 0 if it
+ * is unbounded.
+ */
+uint64_t requestDeadline();
+
+/**
+ * Time out sends and receives on another socket at a deadline, e.g. on a helper
+ * connection opened for the current request.  Safe to call from any thread.
+ * @param deadlineNs from requestDeadline(), 0 for none
+ * @throws DeadlineExceeded if it has passed.
+ */
+void armSocket(int socketFd, uint64_t deadlineNs);
+
+/**
+ * @return true if the last armed request has used up its time, so that an IPC error
+ * is really a timeout.
+ */
+bool requestTimedOut();
+
+/**
+ * Disarm the watchdog and socket timeouts, e.g. before waiting for events indefinitely.
+ */
+void stopDeadlines();
+
+/**
+ * Print the partial-progress report for a timeout to stderr.
+ */
+void reportTimeout(const char *reason);
+
+#endif //I3_SNAPSHOT_DEADLINE_H
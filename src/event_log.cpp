@@ -0,0 +1,195 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "event_log.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <initializer_list>
+#include <unistd.h>
+
+using namespace std;
+
+static EventRecord events[EVENT_LOG_CAPACITY];
+static atomic<uint64_t> nextEvent{0};
+static const uint64_t startNs = eventClockNs();
+
+uint64_t eventClockNs() {
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000u + now.tv_nsec;
+}
+
+void logEvent(EventKind kind, uint16_t code, uint32_t a, uint64_t b, const char *text, size_t length) {
+    EventRecord &event = events[nextEvent.fetch_add(1, memory_order_relaxed) % EVENT_LOG_CAPACITY];
+
+    event.timeNs = eventClockNs();
+    event.kind = kind;
+    event.code = code;
+    event.a = a;
+    event.b = b;
+
+    if (text == nullptr) length = 0;
+    if (length >= EVENT_TEXT_SIZE) length = EVENT_TEXT_SIZE - 1;
+    if (length > 0) memcpy(event.text, text, length);
+    event.text[length] = '\0';
+}
+
+/**
+ * Minimal formatter into a fixed buffer, usable from a signal handler.
+ */
+struct LineWriter {
+    char buffer[160];
+    size_t used = 0;
+
+    void put(const char *text) {
+        while (*text != '\0' && used < sizeof(buffer)) buffer[used++] = *text++;
+    }
+
+    void put(uint64_t value, int minDigits = 1) {
+        char digits[24];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value > 0 || count < minDigits);
+        while (count > 0 && used < sizeof(buffer)) buffer[used++] = digits[--count];
+    }
+
+    void flush(int fd) {
+        if (used < sizeof(buffer)) buffer[used++] = '\n';
+        else buffer[sizeof(buffer) - 1] = '\n';
+        ssize_t ignored = write(fd, buffer, used);
+        (void) ignored;
+        used = 0;
+    }
+};
+
+static const char *kindName(uint16_t kind) {
+    switch (kind) {
+        case EV_START:
+            return "start mode=";
+        case EV_TREE:
+            return "tree containers=";
+        case EV_PLAN:
+            return "plan commands=";
+        case EV_COMMAND:
+            return "command batch=";
+        case EV_REPLY:
+            return "reply batch=";
+        case EV_DEFERRED:
+            return "deferred steps=";
+        case EV_ERROR:
+            return "error";
+        case EV_OUTPUTS:
+            return "outputs count=";
+        default:
+            return "unknown a=";
+    }
+}
+
+static const char *secondName(uint16_t kind) {
+    switch (kind) {
+        case EV_TREE:
+            return " workspaces=";
+        case EV_PLAN:
+            return " batches=";
+        case EV_COMMAND:
+            return " bytes=";
+        case EV_REPLY:
+            return " us=";
+        case EV_OUTPUTS:
+            return " active=";
+        default:
+            return nullptr;
+    }
+}
+
+void dumpEventLog(int fd) {
+    uint64_t end = nextEvent.load(memory_order_relaxed);
+    uint64_t begin = end > EVENT_LOG_CAPACITY ? end - EVENT_LOG_CAPACITY : 0;
+
+    LineWriter line;
+    line.put("i3-snapshot event log: ");
+    line.put(end - begin);
+    line.put(" of ");
+    line.put(end);
+    line.put(" events");
+    line.flush(fd);
+
+    for (uint64_t i = begin; i < end; i++) {
+        const EventRecord &event = events[i % EVENT_LOG_CAPACITY];
+        uint64_t elapsedUs = event.timeNs > startNs ? (event.timeNs - startNs) / 1000 : 0;
+
+        line.put("+");
+        line.put(elapsedUs / 1000000);
+        line.put(".");
+        line.put(elapsedUs % 1000000, 6);
+        line.put(" ");
+        line.put(kindName(event.kind));
+        if (event.kind != EV_ERROR) line.put(event.a);
+        if (secondName(event.kind) != nullptr) {
+            line.put(secondName(event.kind));
+            line.put(event.b);
+        }
+        if (event.kind == EV_REPLY) line.put(event.code != 0 ? " ok" : " failed");
+        if (event.text[0] != '\0') {
+            line.put(" ");
+            line.put(event.text);
+        }
+        line.flush(fd);
+    }
+}
+
+static void handleDumpSignal(int) {
+    dumpEventLog(STDERR_FILENO);
+}
+
+static void handleFatalSignal(int signal) {
+    dumpEventLog(STDERR_FILENO);
+    ::signal(signal, SIG_DFL);
+    raise(signal);
+}
+
+void installEventLogSignalHandlers() {
+    struct sigaction action{};
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+
+    action.sa_handler = handleDumpSignal;
+    sigaction(SIGUSR1, &action, nullptr);
+
+    action.sa_handler = handleFatalSignal;
+    action.sa_flags = SA_RESETHAND;
+    for (int fatal : {SIGSEGV, SIGABRT, SIGBUS, SIGTERM})
+        sigaction(fatal, &action, nullptr);
+}
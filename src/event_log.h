@@ -0,0 +1,88 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_EVENT_LOG_H
+#define I3_SNAPSHOT_EVENT_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Always-on, fixed-size in-memory ring of binary events.  Recording an event is a
+ * clock read, an atomic increment and a small copy; nothing is formatted until the
+ * log is dumped on failure, on SIGUSR1 or on request.
+ */
+
+enum EventKind : uint16_t {
+    EV_START,       // a: mode
+    EV_TREE,        // a: containers, b: workspaces
+    EV_PLAN,        // a: commands, b: batches
+    EV_COMMAND,     // a: batch, b: bytes, text: start of payload
+    EV_REPLY,       // code: 1 on success, a: batch, b: elapsed microseconds
+    EV_DEFERRED,    // a: steps, text: workspace name
+    EV_ERROR,       // text: message
+    EV_OUTPUTS,     // code: 1 once all wanted outputs are active, a: outputs, b: wanted outputs active
+};
+
+const size_t EVENT_LOG_CAPACITY = 4096;
+const size_t EVENT_TEXT_SIZE = 48;
+
+struct EventRecord {
+    uint64_t timeNs;
+    uint16_t kind;
+    uint16_t code;
+    uint32_t a;
+    uint64_t b;
+    char text[EVENT_TEXT_SIZE];
+};
+
+/**
+ * Append an event, overwriting the oldest once the ring is full.
+ * @param text optional, truncated to EVENT_TEXT_SIZE - 1 bytes.
+ */
+void logEvent(EventKind kind, uint16_t code, uint32_t a, uint64_t b, const char *text = nullptr, size_t length = 0);
+
+/**
+ * @return monotonic clock in nanoseconds, as stamped on events.
+ */
+uint64_t eventClockNs();
+
+/**
+ * Write the ring as text, oldest event first.  Async-signal-safe.
+ * @param fd destination file descriptor
+ */
+void dumpEventLog(int fd);
+
+/**
+ * Dump the log to stderr on SIGUSR1 and before dying on fatal signals.
+ */
+void installEventLogSignalHandlers();
+
+#endif //I3_SNAPSHOT_EVENT_LOG_H
@@ -0,0 +1,86 @@
+/*
+ * i3-snapshot C API.
+ *
+ * A stable C ABI over the snapshot engine for callers that do not want to spawn
+ * the i3-snapshot binary and parse its text output (status bars, session scripts,
+ * Python via ctypes).  Structs are only ever extended by appending fields, and
+ * records are always reached through i3snap_get() so that growth stays compatible.
+ *
+ * Strings returned by the library are owned by the snapshot they came from and stay
+ * valid until i3snap_free() is called on it.
+ */
+
+#ifndef I3_SNAPSHOT_C_API_H
+#define I3_SNAPSHOT_C_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define I3SNAP_ABI_VERSION 2
+
+/* Flags for i3snap_restore() and i3snap_format(). */
+#define I3SNAP_MATCH_TITLE  (1 << 0)  /* identify windows by title instead of i3 id */
+#define I3SNAP_CONTINUE     (1 << 1)  /* keep going after a failed move */
+#define I3SNAP_DRYRUN       (1 << 2)  /* compute but do not send commands */
+#define I3SNAP_RAW_STRINGS  (1 << 3)  /* tab separated, escaped names instead of base64 */
+
+/* Values of i3snap_window.placement. */
+#define I3SNAP_PLACEMENT_TILING     0
+#define I3SNAP_PLACEMENT_FLOATING   1
+#define I3SNAP_PLACEMENT_SCRATCHPAD 2
+
+typedef struct i3snap_window {
+    const char *output_name;
+    const char *workspace_name;
+    uint64_t workspace_id;
+    uint64_t window_id;
+    const char *window_name;
+    /* Since ABI version 2. */
+    int placement;            /* I3SNAP_PLACEMENT_* */
+    const char *mark;         /* snapshot mark of the window, "" if taken without marks */
+} i3snap_window;
+
+typedef struct i3snap_snapshot i3snap_snapshot;
+
+/* @return I3SNAP_ABI_VERSION of the loaded library. */
+int i3snap_abi_version(void);
+
+/* Capture the current layout.  socket_path may be NULL to use the session's i3. */
+i3snap_snapshot *i3snap_capture(const char *socket_path);
+
+/* Parse snapshot text as written by i3-snapshot or i3snap_format(). */
+i3snap_snapshot *i3snap_parse(const char *data, size_t length);
+
+/* Serialize to the snapshot text format.  Release the result with i3snap_string_free(). */
+char *i3snap_format(const i3snap_snapshot *snapshot, int flags);
+
+void i3snap_string_free(char *text);
+
+size_t i3snap_size(const i3snap_snapshot *snapshot);
+
+/* @return the record at index, or NULL if out of range. */
+const i3snap_window *i3snap_get(const i3snap_snapshot *snapshot, size_t index);
+
+/* Records of saved whose windows are placed differently in live. */
+i3snap_snapshot *i3snap_diff(const i3snap_snapshot *saved, const i3snap_snapshot *live);
+
+/*
+ * @return number of failed commands plus missing windows, or -1 on connection errors.
+ * Nothing is printed; when the result is not 0, i3snap_last_error() describes the failures.
+ */
+int i3snap_restore(const char *socket_path, const i3snap_snapshot *snapshot, int flags);
+
+void i3snap_free(i3snap_snapshot *snapshot);
+
+/* @return description of the last failure on this thread, or NULL. */
+const char *i3snap_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* I3_SNAPSHOT_C_API_H */
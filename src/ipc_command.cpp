@@ -0,0 +1,181 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ipc_command.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+
+using namespace std;
+
+/**
+ * https://i3wm.org/docs/ipc.html#_sending_messages_to_i3
+ */
+static const char IPC_MAGIC[] = "i3-ipc";
+static const size_t IPC_MAGIC_BYTES = 6;
+static const uint32_t IPC_RUN_COMMAND = 0;
+
+struct __attribute__((packed)) IpcHeader {
+    char magic[IPC_MAGIC_BYTES];
+    uint32_t size;
+    uint32_t type;
+};
+
+static void sendAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) throw runtime_error(string("Unable to send to i3: ") + strerror(errno));
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+}
+
+static void receiveAll(int fd, char *data, size_t size) {
+    while (size > 0) {
+        ssize_t received = recv(fd, data, size, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received == 0) throw runtime_error("i3 closed the connection");
+        if (received < 0) throw runtime_error(string("Unable to read from i3: ") + strerror(errno));
+        data += received;
+        size -= static_cast<size_t>(received);
+    }
+}
+
+vector<CommandResult> sendCommands(const i3ipc::connection &i3conn, const string &payload) {
+    // i3ipc++ does not mark the getter const, reading the descriptor changes nothing.
+    int fd = const_cast<i3ipc::connection &>(i3conn).get_main_socket_fd();
+
+    IpcHeader header{};
+    memcpy(header.magic, IPC_MAGIC, IPC_MAGIC_BYTES);
+    header.size = static_cast<uint32_t>(payload.size());
+    header.type = IPC_RUN_COMMAND;
+
+    string message(reinterpret_cast<const char *>(&header), sizeof(header));
+    message += payload;
+    sendAll(fd, message.data(), message.size());
+
+    receiveAll(fd, reinterpret_cast<char *>(&header), sizeof(header));
+    if (memcmp(header.magic, IPC_MAGIC, IPC_MAGIC_BYTES) != 0 || header.type != IPC_RUN_COMMAND)
+        throw runtime_error("Unexpected reply from i3");
+
+    string reply(header.size, '\0');
+    receiveAll(fd, &reply[0], reply.size());
+
+    return parseCommandReply(reply);
+}
+
+/**
+ * @return the position after the JSON string starting at begin, or npos if unterminated.
+ */
+static size_t skipString(const string &json, size_t begin) {
+    for (size_t i = begin + 1; i < json.size(); i++) {
+        if (json[i] == '\\') i++;
+        else if (json[i] == '"') return i + 1;
+    }
+    return string::npos;
+}
+
+static size_t skipSpace(const string &json, size_t i) {
+    while (i < json.size() && isspace(static_cast<unsigned char>(json[i]))) i++;
+    return i;
+}
+
+/**
+ * Decode the common escapes of a JSON string body; \u escapes are kept as they are.
+ */
+static string unescapeJson(const string &json, size_t begin, size_t end) {
+    string out;
+    out.reserve(end - begin);
+
+    for (size_t i = begin; i < end; i++) {
+        if (json[i] != '\\' || i + 1 == end) {
+            out += json[i];
+            continue;
+        }
+
+        char escaped = json[++i];
+        if (escaped == 'n') out += '\n';
+        else if (escaped == 't') out += '\t';
+        else if (escaped == 'u') out += "\\u";
+        else out += escaped;
+    }
+
+    return out;
+}
+
+vector<CommandResult> parseCommandReply(const string &reply) {
+    // Only "success" and "error" of the objects in the top level array matter, so this
+    // tracks nesting and strings rather than building a document.
+    vector<CommandResult> results;
+    int depth = 0;
+
+    for (size_t i = 0; i < reply.size();) {
+        char c = reply[i];
+
+        if (c == '"') {
+            size_t end = skipString(reply, i);
+            if (end == string::npos) break;
+
+            string key = reply.substr(i + 1, end - i - 2);
+            size_t value = skipSpace(reply, end);
+            bool isKey = depth == 2 && !results.empty() && value < reply.size() && reply[value] == ':';
+            if (!isKey) {
+                i = end;
+                continue;
+            }
+
+            value = skipSpace(reply, value + 1);
+            if (key == "success") {
+                results.back().success = reply.compare(value, 4, "true") == 0;
+            } else if (key == "error" && value < reply.size() && reply[value] == '"') {
+                size_t valueEnd = skipString(reply, value);
+                if (valueEnd == string::npos) break;
+                results.back().error = unescapeJson(reply, value + 1, valueEnd - 1);
+            }
+            i = value;
+            continue;
+        }
+
+        if (c == '[' || c == '{') {
+            depth++;
+            if (c == '{' && depth == 2) results.emplace_back();
+        } else if (c == ']' || c == '}') {
+            depth--;
+        }
+        i++;
+    }
+
+    return results;
+}
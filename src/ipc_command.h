@@ -0,0 +1,63 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_IPC_COMMAND_H
+#define I3_SNAPSHOT_IPC_COMMAND_H
+
+#include <i3ipc++/ipc.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * Outcome of one command of a COMMAND message.
+ */
+struct CommandResult {
+    bool success{};
+    // i3's error message, if it gave one.
+    std::string error;
+};
+
+/**
+ * Send chained commands as one COMMAND message and return the result of each.
+ * i3ipc++'s send_command() reports only the first entry of the reply, which hides every
+ * later failure of a batch, so the message is sent on the connection's socket directly.
+ * @param i3conn connection that is not waiting on another reply
+ * @param payload commands separated by ';'
+ * @return one result per command i3 ran; i3 stops at a command it cannot parse.
+ * @throws std::runtime_error if the socket fails or times out, see armRequest().
+ */
+std::vector<CommandResult> sendCommands(const i3ipc::connection &i3conn, const std::string &payload);
+
+/**
+ * Parse the reply to a COMMAND message, a JSON array with one object per command.
+ */
+std::vector<CommandResult> parseCommandReply(const std::string &reply);
+
+#endif //I3_SNAPSHOT_IPC_COMMAND_H
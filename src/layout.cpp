@@ -0,0 +1,615 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "layout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "base64.h"
+#include "deadline.h"
+#include "event_log.h"
+#include "prefetch.h"
+
+using namespace std;
+
+static const uint32_t NONE = ConRecord::NONE;
+
+static void captureNode(const i3ipc::container_t &c, LayoutNode &node) {
+    node.id = c.id;
+    node.xwindowId = c.xwindow_id;
+    node.type = c.type;
+    node.layout = c.layout_raw;
+    node.percent = c.percent;
+    node.name = c.name;
+
+    if (isWindow(c)) return;
+
+    for (auto &child : c.nodes) {
+        node.children.emplace_back();
+        captureNode(*child, node.children.back());
+    }
+}
+
+static void captureWorkspaces(const i3ipc::container_t &c, LayoutNode &layout) {
+    if (c.type == "workspace") {
+        // Skip i3 internal workspaces such as __i3_scratch.
+        if (c.name.compare(0, 2, "__") == 0) return;
+
+        layout.children.emplace_back();
+        captureNode(c, layout.children.back());
+        return;
+    }
+
+    if (isValidParent(c))
+        for (auto &child : c.nodes)
+            captureWorkspaces(*child, layout);
+}
+
+LayoutNode captureLayout(const i3ipc::container_t &root) {
+    LayoutNode layout;
+    layout.type = "root";
+
+    captureWorkspaces(root, layout);
+
+    return layout;
+}
+
+static void writeNode(ostream &out, const LayoutNode &node, size_t depth) {
+    // An empty field would shift the columns, "=" decodes to the empty string.
+    string name = base64_encode(reinterpret_cast<const unsigned char *>(node.name.c_str()), node.name.length());
+    if (name.empty()) name = "=";
+
+    // Depth, Type, Container Id, X Window Id, Layout, Percent, Name
+    out << depth << " " << node.type << " " << node.id << " " << node.xwindowId << " "
+        << (node.layout.empty() ? "-" : node.layout) << " " << node.percent << " " << name << "\n";
+
+    for (auto &child : node.children)
+        writeNode(out, child, depth + 1);
+}
+
+void writeLayout(ostream &out, const LayoutNode &layout) {
+    out << LAYOUT_HEADER << "\n";
+
+    for (auto &workspace : layout.children)
+        writeNode(out, workspace, 0);
+
+    out.flush();
+}
+
+bool isLayoutHeader(const string &line) {
+    return line.compare(0, sizeof(LAYOUT_HEADER) - 1, LAYOUT_HEADER) == 0;
+}
+
+bool readLayoutHeader(istream &in) {
+    if (in.peek() != LAYOUT_HEADER[0]) return false;
+
+    string line;
+    getline(in, line);
+    if (!isLayoutHeader(line))
+        throw invalid_argument("Unrecognized snapshot header: '" + line + "'");
+    return true;
+}
+
+LayoutNode readLayout(istream &in) {
+    LayoutNode layout;
+    layout.type = "root";
+
+    vector<LayoutNode *> ancestors{&layout};
+    string line;
+    size_t lineNumber = 1;
+
+    while (getline(in, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#') continue;
+
+        istringstream fields(line);
+        size_t depth;
+        LayoutNode node;
+        string nameEnc;
+
+        if (!(fields >> depth >> node.type >> node.id >> node.xwindowId >> node.layout >> node.percent >> nameEnc))
+            throw invalid_argument("Malformed layout line " + to_string(lineNumber) + ": '" + line + "'");
+        if (depth + 1 > ancestors.size())
+            throw invalid_argument("Layout line " + to_string(lineNumber) + " skips a level");
+
+        if (node.layout == "-") node.layout.clear();
+        node.name = base64_decode(nameEnc);
+        node.line = lineNumber;
+
+        ancestors.resize(depth + 1);
+        LayoutNode *parent = ancestors.back();
+        parent->children.push_back(move(node));
+        ancestors.push_back(&parent->children.back());
+    }
+
+    return layout;
+}
+
+/**
+ * i3 command argument for a layout name as reported in the tree.
+ */
+static string layoutCommand(const string &layout) {
+    return layout == "stacked" ? "stacking" : layout;
+}
+
+/**
+ * Computes the edit script against a model of the live tree that is updated as commands
+ * are emitted, the way i3 will apply them.
+ */
+class LayoutPlanner {
+public:
+    LayoutPlanner(const ConIndex &live, const WorkspaceIndex &workspaces) : live(live), workspaces(workspaces) {
+        const vector<ConRecord> &records = live.all();
+        model.resize(records.size());
+
+        for (uint32_t i = 0; i < records.size(); i++) {
+            const ConRecord &record = records[i];
+            ModelCon &con = model[i];
+            con.conId = record.id;
+            con.parent = record.parent;
+            con.layout = record.container->layout_raw;
+            con.percent = record.container->percent;
+            con.workspace = record.container->type == "workspace";
+            con.window = isWindow(*record.container);
+
+            // Floating containers are out of reach of tiling moves and swaps.
+            if (record.parent != NONE && !record.floating) model[record.parent].children.push_back(i);
+        }
+    }
+
+    RestorePlan plan(const LayoutNode &saved) {
+        struct Target {
+            const LayoutNode *node;
+            uint32_t workspace;
+            PlanPriority priority;
+        };
+        vector<Target> targets;
+
+        for (auto &workspace : saved.children) {
+            for (auto &child : workspace.children) match(child);
+
+            const LiveWorkspace *liveWorkspace = workspaces.resolve(workspace.id, workspace.name);
+            uint32_t position = liveWorkspace != nullptr ? positionOf(live.find(liveWorkspace->id)) : NONE;
+            if (position == NONE) {
+                countMissing(workspace);
+                continue;
+            }
+
+            targets.push_back(Target{&workspace, position, workspacePriority(liveWorkspace)});
+        }
+
+        stable_sort(targets.begin(), targets.end(), [](const Target &a, const Target &b) {
+            return a.priority < b.priority;
+        });
+
+        for (auto &target : targets) {
+            workspaceName = target.node->name;
+            priority = target.priority;
+
+            setLayout(target.workspace, target.node->layout, *target.node);
+            placeChildren(*target.node, target.workspace);
+        }
+
+        finish();
+        return result;
+    }
+
+private:
+    struct ModelCon {
+        size_t conId{};
+        std::string mark;
+        uint32_t parent{NONE};
+        std::vector<uint32_t> children;
+        std::string layout;
+        double percent{-1};
+        bool workspace{};
+        bool window{};
+        bool claimed{};
+    };
+
+    const ConIndex &live;
+    const WorkspaceIndex &workspaces;
+    vector<ModelCon> model;
+    unordered_map<const LayoutNode *, uint32_t> matched;
+    vector<string> marks;
+    RestorePlan result;
+    string workspaceName;
+    PlanPriority priority{PRIORITY_HIDDEN};
+    bool focusChanged{};
+
+    struct Resize {
+        uint32_t con;
+        uint32_t parent;
+        string parentLayout;
+        double percent;
+        const LayoutNode *node;
+    };
+    vector<Resize> resizes;
+
+    uint32_t positionOf(const ConRecord *record) const {
+        return record == nullptr ? NONE : static_cast<uint32_t>(record - &live.all()[0]);
+    }
+
+    string ref(uint32_t con) const {
+        if (model[con].conId != 0) return "[con_id=" + to_string(model[con].conId) + "]";
+        return "[con_mark=\"^" + model[con].mark + "$\"]";
+    }
+
+    void emit(PlanStepKind kind, string command, const LayoutNode &node) {
+        appendStep(result, PlanStep{kind, move(command), workspaceName, node.line}, priority);
+    }
+
+    void countMissing(const LayoutNode &node) {
+        if (node.isWindow()) {
+            result.records++;
+            result.missingLines.push_back(node.line);
+        }
+        for (auto &child : node.children) countMissing(child);
+    }
+
+    /**
+     * Match a saved subtree to live containers, children first.
+     */
+    uint32_t match(const LayoutNode &node) {
+        uint32_t found = NONE;
+
+        if (node.isWindow()) {
+            const ConRecord *record = live.find(node.id);
+            if (record == nullptr || record->xwindowId != node.xwindowId) record = live.findByXWindow(node.xwindowId);
+            found = positionOf(record);
+        } else {
+            for (auto &child : node.children) match(child);
+
+            const ConRecord *record = live.find(node.id);
+            uint32_t byId = positionOf(record);
+            if (byId != NONE && !model[byId].window && !model[byId].workspace && !model[byId].claimed) {
+                found = byId;
+            } else {
+                found = matchByChildren(node);
+            }
+        }
+
+        if (found != NONE) {
+            model[found].claimed = true;
+            matched[&node] = found;
+        }
+        return found;
+    }
+
+    /**
+     * A container recreated by i3 has a new id; take the live parent most of its matched
+     * children share, provided that parent holds nothing else.
+     */
+    uint32_t matchByChildren(const LayoutNode &node) {
+        unordered_map<uint32_t, size_t> votes;
+        unordered_set<uint32_t> children;
+
+        for (auto &child : node.children) {
+            auto found = matched.find(&child);
+            if (found == matched.end()) continue;
+            children.insert(found->second);
+            votes[model[found->second].parent]++;
+        }
+
+        uint32_t best = NONE;
+        size_t bestVotes = 0;
+        for (auto &vote : votes) {
+            if (vote.second > bestVotes) {
+                best = vote.first;
+                bestVotes = vote.second;
+            }
+        }
+
+        if (best == NONE || model[best].claimed || model[best].workspace || model[best].window) return NONE;
+
+        for (auto child : model[best].children)
+            if (children.count(child) == 0) return NONE;
+
+        return best;
+    }
+
+    uint32_t matchedCon(const LayoutNode &node) const {
+        auto found = matched.find(&node);
+        return found == matched.end() ? NONE : found->second;
+    }
+
+    string markOf(uint32_t con, const LayoutNode &node) {
+        if (model[con].mark.empty()) {
+            model[con].mark = "_snap_layout_" + to_string(marks.size());
+            marks.push_back(model[con].mark);
+            emit(EDIT_MARK, ref(con) + " mark --add " + model[con].mark, node);
+        }
+        return model[con].mark;
+    }
+
+    /**
+     * Take a container out of its parent; i3 closes split containers left empty.
+     */
+    void detach(uint32_t con) {
+        uint32_t parent = model[con].parent;
+        if (parent == NONE) return;
+
+        auto &siblings = model[parent].children;
+        siblings.erase(remove(siblings.begin(), siblings.end(), con), siblings.end());
+        model[con].parent = NONE;
+
+        if (siblings.empty() && !model[parent].workspace && !model[parent].window) detach(parent);
+    }
+
+    void moveInto(uint32_t con, uint32_t target, const LayoutNode &node) {
+        emit(EDIT_MOVE, ref(con) + " move container to mark " + markOf(target, node), node);
+
+        detach(con);
+        model[target].children.push_back(con);
+        model[con].parent = target;
+    }
+
+    void setLayout(uint32_t con, const string &layout, const LayoutNode &node) {
+        if (layout.empty() || layout == "output" || layout == "dockarea" || model[con].layout == layout) return;
+
+        // i3 applies a layout command to the parent of the selected container unless that is a
+        // workspace, so a split container is reached through one of its children.
+        if (model[con].workspace) {
+            emit(EDIT_LAYOUT, ref(con) + " layout " + layoutCommand(layout), node);
+        } else {
+            if (model[con].children.empty()) return;
+            emit(EDIT_LAYOUT, ref(model[con].children.front()) + " layout " + layoutCommand(layout), node);
+        }
+        model[con].layout = layout;
+    }
+
+    /**
+     * Wrap a window in a new split container, marking the container so it can be addressed.
+     * @return the new container, or the parent when i3 would only reorient it.
+     */
+    uint32_t split(uint32_t seed, const LayoutNode &node) {
+        uint32_t parent = model[seed].parent;
+        bool vertical = node.layout == "splitv";
+        string command = ref(seed) + " split " + (vertical ? "v" : "h");
+
+        // i3 reorients a split parent with a single child instead of nesting a new one.
+        if (model[parent].children.size() == 1 && (model[parent].layout == "splith" || model[parent].layout == "splitv")) {
+            emit(EDIT_SPLIT, command, node);
+            model[parent].layout = vertical ? "splitv" : "splith";
+            return parent;
+        }
+
+        uint32_t created = static_cast<uint32_t>(model.size());
+        model.emplace_back();
+        ModelCon &wrapper = model.back();
+        wrapper.mark = "_snap_layout_" + to_string(marks.size());
+        wrapper.layout = vertical ? "splitv" : "splith";
+        wrapper.parent = parent;
+        wrapper.children.push_back(seed);
+        wrapper.claimed = true;
+        marks.push_back(wrapper.mark);
+
+        emit(EDIT_SPLIT, command + "; " + ref(seed) + " focus; focus parent; mark --add " + wrapper.mark, node);
+        focusChanged = true;
+
+        replace(model[parent].children.begin(), model[parent].children.end(), seed, created);
+        model[seed].parent = created;
+
+        return created;
+    }
+
+    uint32_t firstLiveWindow(const LayoutNode &node) const {
+        if (node.isWindow()) return matchedCon(node);
+
+        for (auto &child : node.children) {
+            uint32_t found = firstLiveWindow(child);
+            if (found != NONE) return found;
+        }
+        return NONE;
+    }
+
+    /**
+     * Put the live counterpart of a saved node into parent.
+     * @return the placed containers, several when a container collapsed into parent.
+     */
+    vector<uint32_t> place(const LayoutNode &node, uint32_t parent) {
+        uint32_t con = matchedCon(node);
+
+        if (node.isWindow()) {
+            result.records++;
+            if (con == NONE) {
+                result.missingLines.push_back(node.line);
+                return {};
+            }
+
+            if (model[con].parent != parent) moveInto(con, parent, node);
+            else result.inPlace++;
+            return {con};
+        }
+
+        if (con == NONE) {
+            uint32_t seed = firstLiveWindow(node);
+            if (seed == NONE) {
+                countMissing(node);
+                return {};
+            }
+
+            uint32_t seedParent = model[seed].parent;
+            if (seedParent != NONE && model[seedParent].children.size() == 1 && !model[seedParent].workspace &&
+                !model[seedParent].claimed) {
+                // The seed already sits alone in an unused container: adopt it.
+                con = seedParent;
+                model[con].claimed = true;
+            } else {
+                if (seedParent == NONE || model[seedParent].children.size() == 1) moveInto(seed, parent, node);
+                con = split(seed, node);
+            }
+            matched[&node] = con;
+
+            if (con == parent) {
+                // Collapsed into the parent: the saved container's children become its children.
+                vector<uint32_t> placed;
+                for (auto &child : node.children) {
+                    auto childPlaced = place(child, parent);
+                    placed.insert(placed.end(), childPlaced.begin(), childPlaced.end());
+                }
+                return placed;
+            }
+        }
+
+        if (model[con].parent != parent) moveInto(con, parent, node);
+        // Set once the children are in place, as the command goes through one of them.
+        placeChildren(node, con);
+        setLayout(con, node.layout, node);
+
+        return {con};
+    }
+
+    void placeChildren(const LayoutNode &node, uint32_t parent) {
+        vector<uint32_t> desired;
+
+        for (auto &child : node.children) {
+            vector<uint32_t> placed = place(child, parent);
+            if (placed.size() == 1) resizes.push_back(Resize{placed[0], parent, node.layout, child.percent, &child});
+            desired.insert(desired.end(), placed.begin(), placed.end());
+        }
+
+        reorder(parent, desired, node);
+    }
+
+    /**
+     * Bring the desired children of parent into order with at most k - 1 swaps.
+     */
+    void reorder(uint32_t parent, const vector<uint32_t> &desired, const LayoutNode &node) {
+        unordered_set<uint32_t> wanted(desired.begin(), desired.end());
+
+        vector<size_t> slots;
+        auto &children = model[parent].children;
+        for (size_t i = 0; i < children.size(); i++)
+            if (wanted.count(children[i]) > 0) slots.push_back(i);
+
+        if (slots.size() != desired.size()) return;
+
+        unordered_map<uint32_t, size_t> slotOf;
+        for (size_t i = 0; i < slots.size(); i++) slotOf[children[slots[i]]] = i;
+
+        for (size_t i = 0; i < desired.size(); i++) {
+            uint32_t current = children[slots[i]];
+            if (current == desired[i]) continue;
+
+            size_t other = slotOf[desired[i]];
+            string with = model[desired[i]].conId != 0 ? "con_id " + to_string(model[desired[i]].conId)
+                                                       : "mark " + markOf(desired[i], node);
+            emit(EDIT_SWAP, ref(current) + " swap container with " + with, node);
+
+            swap(children[slots[i]], children[slots[other]]);
+            slotOf[current] = other;
+            slotOf[desired[i]] = i;
+        }
+    }
+
+    void finish() {
+        priority = PRIORITY_HIDDEN;
+
+        for (auto &resize : resizes) {
+            const char *dimension = resize.parentLayout == "splith" ? "width"
+                                    : resize.parentLayout == "splitv" ? "height" : nullptr;
+            if (dimension == nullptr || resize.percent <= 0 || model[resize.parent].children.size() < 2) continue;
+            if (fabs(model[resize.con].percent - resize.percent) < 0.01) continue;
+
+            workspaceName.clear();
+            emit(EDIT_RESIZE, ref(resize.con) + " resize set " + dimension + " " +
+                              to_string(lround(resize.percent * 100)) + " ppt", *resize.node);
+        }
+
+        LayoutNode none;
+        if (focusChanged) {
+            for (auto &record : live.all()) {
+                if (record.container->focused) {
+                    emit(EDIT_FOCUS, "[con_id=" + to_string(record.id) + "] focus", none);
+                    break;
+                }
+            }
+        }
+
+        for (auto &mark : marks) emit(EDIT_MARK, "unmark " + mark, none);
+    }
+};
+
+RestorePlan planLayout(const LayoutNode &saved, const ConIndex &live, const WorkspaceIndex &workspaces) {
+    LayoutPlanner planner(live, workspaces);
+    return planner.plan(saved);
+}
+
+RestorePlan planLayoutRestore(const i3ipc::connection &i3conn, const LayoutNode &saved,
+                              const CommandLineOptions &opts) {
+    beginPhase("fetch");
+    LiveState state = fetchLiveState(i3conn, opts.socketPath);
+    ConIndex live(*state.tree);
+    logEvent(EV_TREE, 0, live.all().size(), state.workspaces.size());
+
+    WorkspaceIndex workspaces(*state.tree, state.workspaces, true);
+
+    RestorePlan plan = planLayout(saved, live, workspaces);
+    logEvent(EV_PLAN, 0, plan.commandCount(), plan.batches.size());
+
+    return plan;
+}
+
+/**
+ * @return true if the plan moves or creates containers, which changes ids and order.
+ */
+static bool isStructural(const RestorePlan &plan) {
+    for (auto &batch : plan.batches)
+        for (auto &step : batch.steps)
+            if (step.kind == EDIT_MOVE || step.kind == EDIT_SPLIT) return true;
+    return false;
+}
+
+size_t restoreLayout(const i3ipc::connection &i3conn, const LayoutNode &saved, const CommandLineOptions &opts) {
+    const int maxPasses = 3;
+    size_t failures = 0;
+
+    for (int pass = 0; pass < maxPasses; pass++) {
+        RestorePlan plan = planLayoutRestore(i3conn, saved, opts);
+
+        if (pass == 0)
+            for (auto line : plan.missingLines) cerr << "Window of line " << line << " not found." << endl;
+        if (pass == 0 && !plan.missingLines.empty() && opts.failFast) return plan.missingLines.size();
+
+        beginPhase("restore");
+        failures = plan.missingLines.size() + executePlan(i3conn, plan, opts);
+
+        if (opts.dryRun || (failures > plan.missingLines.size() && opts.failFast) || !isStructural(plan)) break;
+    }
+
+    return failures;
+}
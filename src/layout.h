@@ -0,0 +1,128 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_LAYOUT_H
+#define I3_SNAPSHOT_LAYOUT_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "plan.h"
+
+/**
+ * First line of a full-layout snapshot, which records the nesting of split, tabbed and
+ * stacked containers inside each workspace rather than only window placement.
+ */
+const char LAYOUT_HEADER[] = "# i3-snapshot layout 1";
+
+/**
+ * A workspace, split container or window of a full-layout snapshot.
+ */
+struct LayoutNode {
+    size_t id{};
+    size_t xwindowId{};
+    std::string type;
+    std::string layout;
+    double percent{};
+    std::string name;
+    size_t line{};
+    std::vector<LayoutNode> children;
+
+    bool isWindow() const { return xwindowId != 0; }
+};
+
+/**
+ * Record the container structure of every workspace.
+ * @param root root of the i3 tree
+ * @return a node of type "root" whose children are the workspaces.
+ */
+LayoutNode captureLayout(const i3ipc::container_t &root);
+
+/**
+ * Write a full-layout snapshot, one container per line indented by depth.
+ * @param out destination stream
+ * @param layout result of captureLayout()
+ */
+void writeLayout(std::ostream &out, const LayoutNode &layout);
+
+/**
+ * @return true if the line is the header of a full-layout snapshot.
+ */
+bool isLayoutHeader(const std::string &line);
+
+/**
+ * Consume the header line of a full-layout snapshot if the input starts with one.
+ * @param in snapshot input
+ * @return true if the input is a full-layout snapshot.
+ * @throws std::invalid_argument if the input starts with an unknown header.
+ */
+bool readLayoutHeader(std::istream &in);
+
+/**
+ * Read a full-layout snapshot whose header has already been consumed.
+ * @throws std::invalid_argument if a line is malformed.
+ */
+LayoutNode readLayout(std::istream &in);
+
+/**
+ * Compute an edit script turning the live tree into the saved layout, by greedy matching.
+ *
+ * Saved containers are matched to live ones by con_id and windows also by X window id;
+ * unmatched containers are matched bottom-up to the live parent their children share.
+ * Each match is taken as found, with no search over alternatives, so the script is not
+ * minimal; what one pass cannot settle is left to the next pass of restoreLayout().
+ * The script then walks the saved tree top-down, moving only containers whose parent
+ * differs, wrapping a seed window with split to create missing containers, fixing the
+ * order of siblings with at most k - 1 swaps, and finally setting layouts and sizes.
+ * Everything is hashing and per-parent linear work, O(n) apart from sorting workspaces.
+ *
+ * @param saved layout from readLayout()
+ * @param live index of the live tree
+ * @param workspaces index of the live workspaces
+ * @return plan whose steps go through the batched command path.
+ */
+RestorePlan planLayout(const LayoutNode &saved, const ConIndex &live, const WorkspaceIndex &workspaces);
+
+/**
+ * Restore a saved layout.  Created containers only get ids once i3 has made them, so
+ * after a pass that moved or created containers the tree is fetched and diffed again
+ * to settle order and sizes, for at most three passes.
+ * @return number of failed commands plus missing windows of the last pass.
+ */
+size_t restoreLayout(const i3ipc::connection &i3conn, const LayoutNode &saved, const CommandLineOptions &opts);
+
+/**
+ * Fetch the live state and plan a layout restore, as used by --plan.
+ */
+RestorePlan planLayoutRestore(const i3ipc::connection &i3conn, const LayoutNode &saved,
+                              const CommandLineOptions &opts);
+
+#endif //I3_SNAPSHOT_LAYOUT_H
@@ -0,0 +1,192 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "lazy.h"
+
+#include "deadline.h"
+#include "event_log.h"
+#include "single_flight.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <list>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * Hidden-workspace steps waiting to be sent, in plan order.  Keyed by the live workspace
+ * the steps were planned against, or by name for one the steps create, since the
+ * snapshot's name of a workspace need not be its live name.
+ */
+struct DeferredWorkspace {
+    size_t workspaceId;
+    string workspaceName;
+    PlanBatch batch;
+
+    bool holds(size_t id, const string &name) const {
+        return workspaceId != 0 ? workspaceId == id : workspaceName == name;
+    }
+};
+
+/**
+ * Send the deferred steps of one workspace as a single batch.
+ */
+static void flushWorkspace(const i3ipc::connection &i3conn, DeferredWorkspace &deferred,
+                           const CommandLineOptions &opts, const char *reason) {
+    logEvent(EV_DEFERRED, 0, deferred.batch.steps.size(), 0, deferred.workspaceName.data(),
+             deferred.workspaceName.size());
+
+    RestorePlan plan;
+    plan.batches.push_back(move(deferred.batch));
+
+    if (opts.debug) cout << "# restoring workspace " << deferred.workspaceName << " (" << reason << ")\n";
+
+    CommandLineOptions batchOpts = opts;
+    batchOpts.failFast = false;
+    executePlan(i3conn, plan, batchOpts);
+}
+
+/**
+ * Point stdin, stdout and stderr at /dev/null, so that the detached process neither
+ * holds the caller's terminal or pipes open nor dies writing to them once they close.
+ */
+static void detachStdio() {
+    int null = open("/dev/null", O_RDWR);
+    if (null < 0) return;
+
+    for (int fd = STDIN_FILENO; fd <= STDERR_FILENO; fd++) dup2(null, fd);
+    if (null > STDERR_FILENO) close(null);
+}
+
+size_t restoreLazily(i3ipc::connection &i3conn, const RestorePlan &plan, const CommandLineOptions &opts,
+                     int idleMs, bool detach) {
+    RestorePlan immediate;
+    list<DeferredWorkspace> deferred;
+
+    for (auto &batch : plan.batches) {
+        if (batch.priority != PRIORITY_HIDDEN) {
+            immediate.batches.push_back(batch);
+            continue;
+        }
+
+        for (auto &step : batch.steps) {
+            auto found = deferred.begin();
+            while (found != deferred.end() && !found->holds(step.workspaceId, step.workspaceName)) ++found;
+            if (found == deferred.end()) {
+                deferred.push_back(DeferredWorkspace{step.workspaceId, step.workspaceName, PlanBatch{}});
+                found = prev(deferred.end());
+            }
+
+            found->batch.bytes += step.command.size() + 2;
+            found->batch.steps.push_back(step);
+        }
+    }
+
+    beginPhase("restore");
+    size_t failures = executePlan(i3conn, immediate, opts);
+    if (failures > 0 && opts.failFast) return failures;
+
+    if (deferred.empty()) return failures;
+
+    if (opts.dryRun) {
+        for (auto &workspace : deferred) flushWorkspace(i3conn, workspace, opts, "deferred");
+        return failures;
+    }
+
+    // Deferred workspaces wait on the user, not on i3.
+    stopDeadlines();
+
+    // Subscribe before detaching so no focus event between the two is lost.
+    i3conn.subscribe(i3ipc::ET_WORKSPACE);
+    i3conn.prepare_to_event_handling();
+
+    if (detach) {
+        cout.flush();
+        pid_t pid = fork();
+        if (pid < 0) {
+            cerr << "Failed to detach, restoring deferred workspaces in the foreground." << endl;
+        } else if (pid > 0) {
+            return failures;
+        } else {
+            setsid();
+            detachStdio();
+        }
+    }
+
+    i3conn.signal_workspace_event.connect([&](const i3ipc::workspace_event_t &ev) {
+        if (ev.type != i3ipc::WorkspaceEventType::FOCUS || !ev.current) return;
+
+        for (auto it = deferred.begin(); it != deferred.end(); ++it) {
+            if (it->holds(ev.current->id, ev.current->name)) {
+                flushWorkspace(i3conn, *it, opts, "focused");
+                deferred.erase(it);
+                return;
+            }
+        }
+    });
+
+    try {
+        pollfd events{i3conn.get_event_socket_fd(), POLLIN, 0};
+        while (!deferred.empty()) {
+            int ready = poll(&events, 1, idleMs);
+
+            // A newer restore took over, the deferred steps are stale.
+            if (flightSuperseded()) break;
+
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+
+            if (ready == 0) {
+                flushWorkspace(i3conn, deferred.front(), opts, "idle");
+                deferred.pop_front();
+            } else if (events.revents & POLLIN) {
+                i3conn.handle_event();
+            } else {
+                break;
+            }
+        }
+    } catch (const exception &e) {
+        logEvent(EV_ERROR, 0, 0, 0, e.what(), strlen(e.what()));
+        cerr << "Stopped waiting for workspace events: " << e.what() << endl;
+    }
+
+    if (!deferred.empty())
+        cerr << deferred.size() << " deferred workspaces were not restored." << endl;
+
+    if (detach) _exit(0);
+
+    return failures;
+}
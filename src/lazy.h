@@ -0,0 +1,50 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_LAZY_H
+#define I3_SNAPSHOT_LAZY_H
+
+#include "plan.h"
+
+/**
+ * Restore focused and visible workspaces now and defer the hidden ones.  A deferred
+ * workspace is restored when i3 reports it focused, or when i3 has been idle for
+ * idleMs.  Returns once nothing is deferred any more.
+ * @param i3conn i3 connection, also used to subscribe to workspace events.
+ * @param plan plan from buildPlan()
+ * @param opts restore options
+ * @param idleMs quiet period before a deferred workspace is restored unprompted.
+ * @param detach fork after the immediate batches so the caller does not wait for deferred ones.
+ * @return number of failed immediate commands in the calling process.
+ */
+size_t restoreLazily(i3ipc::connection &i3conn, const RestorePlan &plan, const CommandLineOptions &opts,
+                     int idleMs, bool detach);
+
+#endif //I3_SNAPSHOT_LAZY_H
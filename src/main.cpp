@@ -30,143 +30,34 @@
 
 #include <iostream>
 #include <i3ipc++/ipc.hpp>
+#include <cerrno>
 #include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <memory>
+#include <set>
+#include <sstream>
 #include <zconf.h>
-#include <iomanip>
 
-#include "base64.h"
+#include "atomic_file.h"
+#include "deadline.h"
+#include "event_log.h"
+#include "layout.h"
+#include "lazy.h"
+#include "merge.h"
+#include "plan.h"
+#include "resident.h"
+#include "rules.h"
+#include "script.h"
+#include "service.h"
+#include "settle.h"
+#include "single_flight.h"
+#include "snapshot.h"
+#include "tree_stats.h"
+#include "wait_outputs.h"
 
 using namespace std;
 
-/**
- * Keep track of output and workspace as the i3 container tree is traversed depth-first.
- */
-struct TreeState {
-    string outputName;
-    string workspaceName;
-    size_t workspaceId{};
-};
-
-enum WindowIdentifier {
-    I3_ID, WINDOW_TITLE
-};
-
-struct CommandLineOptions {
-    bool debug;
-    bool failFast;
-    bool forceOutputMode;
-    bool encodeStrings;
-    bool dryRun;
-    WindowIdentifier windowIdentifier;
-};
-
-/**
- * Determine if the i3 container is a window type.
- * @param c i3 container
- * @return true if container is window, false otherwise.
- */
-bool isWindow(const i3ipc::container_t &c) {
-    return c.type == "con" && c.xwindow_id != 0;
-}
-
-/**
- * Determine if container should not be ignored.
- * @param c i3 container
- * @return true if container is valid, false otherwise.
- */
-bool isValidParent(const i3ipc::container_t &c) {
-    return c.type != "dockarea";
-}
-
-/**
- * Traverse i3 containers and emit relevant info to stdout.
- *
- * @param c i3 container
- * @param treeState storage of current state of tree traversal.
- */
-void findWindows(const i3ipc::container_t &c, TreeState &treeState, CommandLineOptions &options) {
-    if (c.type == "output") {
-        treeState.outputName = c.name;
-    } else if (c.type == "workspace") {
-        treeState.workspaceName = c.name;
-        treeState.workspaceId = c.id;
-    } else if (isWindow(c)) {
-        if (treeState.outputName.empty() || treeState.workspaceName.empty()) {
-            cout << "Invalid tree state, aborting." << endl;
-            exit(1);
-        }
-
-        string outputEncoded;
-        string workspaceEncoded;
-        string windowEncoded;
-
-        if (options.encodeStrings) {
-            outputEncoded = base64_encode(reinterpret_cast<const unsigned char *>(treeState.outputName.c_str()),
-                                                 treeState.outputName.length());
-            workspaceEncoded = base64_encode(
-                    reinterpret_cast<const unsigned char *>(treeState.workspaceName.c_str()),
-                    treeState.workspaceName.length());
-            windowEncoded = base64_encode(
-                    reinterpret_cast<const unsigned char *>(c.name.c_str()),
-                    c.name.length());
-        } else {
-            outputEncoded = treeState.outputName;
-            workspaceEncoded = treeState.workspaceName;
-            windowEncoded = c.name;
-        }
-
-        // Output Name, Workspace Name, Workspace Id, Window Id, Window Name
-        cout << outputEncoded << " " << workspaceEncoded << " " <<  treeState.workspaceId << " " << c.id << " "
-             << windowEncoded << endl;
-    }
-
-    if (isValidParent(c))
-        for (auto &node : c.nodes)
-            findWindows(*node, treeState, options);
-}
-
-/**
- * Move a workspace to an out and a window to a workspace.
- * @param i3conn i3 connection
- * @param windowId i3 window id
- * @param outputName system name for output (monitor)
- * @param workspaceName i3 name for workspace
- * @param workspaceId i3 id for workspace
- * @param windowTitle window title
- * @return true if operation success, false otherwise.
- */
-bool
-moveWindow(const i3ipc::connection &i3conn, size_t windowId, const string &outputName, const string &workspaceName,
-           size_t workspaceId, const string &windowTitle, CommandLineOptions &opts) {
-    // Move workspace to output
-    // i3-msg [workspace=" 2 <span foreground='#2aa198'></span> "] move workspace to output "eDP-1"
-    string wsCmd;
-    if (opts.windowIdentifier == I3_ID) {
-        wsCmd = "[con_id=" + to_string(workspaceId) + "] move workspace to output " + outputName;
-    } else {
-        wsCmd = "[workspace=\"" + workspaceName + "\"] move workspace to output " + outputName;
-    }
-
-    if (opts.debug) cout << "i3-msg " << wsCmd << endl;
-
-    if (!opts.dryRun && !i3conn.send_command(wsCmd)) return false;
-
-    // Move window to workspace
-    string windowCmd;
-    // https://build.i3wm.org/docs/userguide.html#command_criteria
-    if (opts.windowIdentifier == I3_ID) {
-        windowCmd = "[con_id=" + to_string(windowId) + "] move container to workspace " + workspaceName;
-    } else {
-        windowCmd = "[title=\"" + windowTitle + "\"] move container to workspace " + workspaceName;
-    }
-
-    if (opts.debug) cout << "i3-msg " << windowCmd << endl;
-
-    if (opts.dryRun) return true;
-    
-    return i3conn.send_command(windowCmd);
-}
-
 /**
  * Determine if input is being passed to program from a pipe.
  * This determines the mode of the program (read/write).
@@ -179,8 +70,31 @@ bool inputFromTerminal() {
 void printHelp() {
     cout
             << "Save and restore window containment in i3-wm.\n"
-            << "Usage: i3-snapshot [-d | --debug] [-v | --verbose] [-c | --continue] [-r | --rawstrings] [-t | --title] [-o | --output] [-y | --dryrun]\n"
+            << "Usage: i3-snapshot [-d | --debug] [-v | --verbose] [-c | --continue] [-r | --rawstrings] [-t | --title] [-o | --output] [-y | --dryrun] [-p | --plan] [--plan-script]\n"
+            << "                   [-l | --lazy] [--lazy-idle MS] [-L | --layout] [--settle] [--settle-quiet MS] [--emit-rules]\n"
+            << "                   [--wait-outputs] [--wait-outputs-quiet MS] [--out FILE [--fsync]] [-m | --marks] [--unmark] [--event-log FILE] [--script [OPERATION...]]\n"
+            << "                   [--timeout MS] [--phase-timeout MS] [--request-timeout MS] [-s | --socket PATH]\n"
+            << "                   [--service PATH [--service-quota BYTES]] [--resident]\n"
+            << "                   [--merge-policy latest|output] [--merge FILE...] [--tree-stats]\n"
             << "-d: debug  -v: version  -c: ignore error  -r: raw strings  -t: match window title  -o: force output mode -y: dryrun\n"
+            << "-p: print restore plan  --plan-script: print restore plan as an i3-msg script\n"
+            << "-l: restore hidden workspaces when focused or idle  --lazy-idle: idle period in ms\n"
+            << "-L: save the full container layout; layout snapshots are detected when restoring\n"
+            << "--settle: after restoring, report how long moved windows kept changing, by class  --settle-quiet: quiet period in ms\n"
+            << "--wait-outputs: before restoring, wait until the snapshot's outputs are active and unchanged  --wait-outputs-quiet: quiet period in ms\n"
+            << "--emit-rules: print i3 assign rules placing the snapshot's windows, for use with include\n"
+            << "--out: write the snapshot to FILE, replacing it only once complete  --fsync: make FILE durable\n"
+            << "-m: mark windows when capturing so the snapshot survives an i3 restart  --unmark: remove those marks\n"
+            << "--script: run operations given as arguments or on stdin over one connection:\n"
+            << "          capture FILE, capture-layout FILE, restore FILE, plan FILE, diff FILE, verify FILE\n"
+            << "--event-log: write the event log to FILE on exit (also dumped to stderr on failure and SIGUSR1)\n"
+            << "--timeout, --phase-timeout, --request-timeout: time limits in ms, 0 for none; exit code 124 on timeout\n"
+            << "-s: i3 IPC socket, defaults to that of the running session\n"
+            << "--service: serve capture and restore for all users on socket PATH  --service-quota: bytes stored per user\n"
+            << "--merge: combine snapshot files into one with each window once, newest file first or\n"
+            << "         with --merge-policy output from the newest file with windows on its output\n"
+            << "--tree-stats: print the shape of the tree as JSON instead of the snapshot, which --out still writes\n"
+            << "--resident: keep capturing and restore windows after i3 restarts in place\n"
             << "Generate a snapshot: i3-snapshot > snapshot.txt\n"
             << "Replay a snapshot: i3-snapshot < snapshot.txt"
             << endl;
@@ -197,14 +111,7 @@ void printVersion() {
  * @return true for debug mode
  */
 CommandLineOptions parseOptions(int argc, char **argv) {
-    CommandLineOptions options{};
-
-    options.debug = false;
-    options.failFast = true;
-    options.forceOutputMode = false;
-    options.encodeStrings = true;
-    options.dryRun = false;
-    options.windowIdentifier = I3_ID;
+    CommandLineOptions options = defaultOptions();
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
@@ -226,6 +133,77 @@ CommandLineOptions parseOptions(int argc, char **argv) {
         } else if (strcmp(argv[i], "-y") == 0 || strcmp(argv[i], "--dryrun") == 0) {
             options.dryRun= true;
             options.debug = true;
+        } else if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--plan") == 0) {
+            options.printPlan = true;
+        } else if (strcmp(argv[i], "--plan-script") == 0) {
+            options.planScript = true;
+        } else if (strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "--lazy") == 0) {
+            options.lazy = true;
+        } else if (strcmp(argv[i], "--lazy-idle") == 0 && i + 1 < argc) {
+            options.lazy = true;
+            options.lazyIdleMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-L") == 0 || strcmp(argv[i], "--layout") == 0) {
+            options.layout = true;
+        } else if (strcmp(argv[i], "--settle") == 0) {
+            options.settleQuietMs = DEFAULT_SETTLE_QUIET_MS;
+        } else if (strcmp(argv[i], "--settle-quiet") == 0 && i + 1 < argc) {
+            options.settleQuietMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--wait-outputs") == 0) {
+            options.outputsQuietMs = DEFAULT_OUTPUTS_QUIET_MS;
+        } else if (strcmp(argv[i], "--wait-outputs-quiet") == 0 && i + 1 < argc) {
+            options.outputsQuietMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--emit-rules") == 0) {
+            options.emitRules = true;
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            options.outPath = argv[++i];
+        } else if (strcmp(argv[i], "--fsync") == 0) {
+            options.fsyncOut = true;
+        } else if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--marks") == 0) {
+            options.marks = true;
+        } else if (strcmp(argv[i], "--unmark") == 0) {
+            options.unmark = true;
+        } else if (strcmp(argv[i], "--script") == 0) {
+            // Everything after --script is an operation.
+            options.script = true;
+            options.scriptOperations.assign(argv + i + 1, argv + argc);
+            break;
+        } else if (strcmp(argv[i], "--merge") == 0) {
+            // Everything after --merge is a snapshot file.
+            options.mergePaths.assign(argv + i + 1, argv + argc);
+            if (options.mergePaths.empty()) {
+                printHelp();
+                exit(1);
+            }
+            break;
+        } else if (strcmp(argv[i], "--merge-policy") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "latest") == 0) {
+                options.mergePolicy = MERGE_LATEST;
+            } else if (strcmp(argv[i], "output") == 0) {
+                options.mergePolicy = MERGE_OUTPUT_OWNER;
+            } else {
+                printHelp();
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--tree-stats") == 0) {
+            options.treeStats = true;
+            options.forceOutputMode = true;
+        } else if (strcmp(argv[i], "--resident") == 0) {
+            options.resident = true;
+        } else if (strcmp(argv[i], "--event-log") == 0 && i + 1 < argc) {
+            options.eventLogPath = argv[++i];
+        } else if ((strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--socket") == 0) && i + 1 < argc) {
+            options.socketPath = argv[++i];
+        } else if (strcmp(argv[i], "--service") == 0 && i + 1 < argc) {
+            options.servicePath = argv[++i];
+        } else if (strcmp(argv[i], "--service-quota") == 0 && i + 1 < argc) {
+            options.serviceQuotaBytes = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            options.runTimeoutMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--phase-timeout") == 0 && i + 1 < argc) {
+            options.phaseTimeoutMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--request-timeout") == 0 && i + 1 < argc) {
+            options.requestTimeoutMs = atoi(argv[++i]);
         } else {
             cout << "Unrecognized command line option: '" << argv[i] << "'.  Aborting." << endl;
             exit(1);
@@ -235,36 +213,258 @@ CommandLineOptions parseOptions(int argc, char **argv) {
     return options;
 }
 
-int main(int argc, char **argv) {
-    CommandLineOptions opts = parseOptions(argc, argv);
+/**
+ * With --wait-outputs, hold off a restore until i3 has finished setting up outputs.  A
+ * restore still follows if they do not settle in time, leaving out missing outputs.
+ * @param wanted outputs the restore needs
+ */
+void awaitOutputs(i3ipc::connection &i3conn, const CommandLineOptions &opts, const set<string> &wanted) {
+    if (opts.outputsQuietMs <= 0) return;
 
-    i3ipc::connection i3connection;
-    TreeState treeState;
+    if (!waitForOutputs(i3conn, wanted, opts.outputsQuietMs))
+        cerr << "Outputs did not settle within " << MAX_OUTPUTS_WAIT_MS << " ms, restoring anyway." << endl;
+}
 
-    if (opts.forceOutputMode || !inputFromTerminal()) {
-        findWindows(*i3connection.get_tree(), treeState, opts);
-    } else {
-        string outputNameEnc, workspaceNameEnc, workspaceIdStr, windowIdStr, windowNameEnc;
+/**
+ * Wait for restores of the session started before this one, see joinFlight().  Dry runs
+ * change nothing and do not wait.
+ * @param result receives the outcome of the restore if this process is not to run it
+ * @return true if this process is to restore.
+ */
+bool takeTurn(const CommandLineOptions &opts, const string &session, const string &key, size_t &result) {
+    if (opts.dryRun) return true;
 
-        while (!cin.eof()) {
-            cin >> outputNameEnc >> workspaceNameEnc >> workspaceIdStr >> windowIdStr >> windowNameEnc;
+    beginPhase("wait");
+    switch (joinFlight(session, key, result)) {
+        case FLIGHT_RUN:
+            return true;
+        case FLIGHT_REUSED:
+            if (opts.debug) cerr << "An identical restore just ran, using its result." << endl;
+            return false;
+        default:
+            cerr << "A newer restore was requested, leaving it to that one." << endl;
+            result = 0;
+            return false;
+    }
+}
 
-            string outputName = base64_decode(outputNameEnc);
-            string workspaceName = base64_decode(workspaceNameEnc);
-            size_t workspaceId = stoul(workspaceIdStr);
-            string windowName = base64_decode(windowNameEnc);
-            size_t windowId = stoul(windowIdStr);
+/**
+ * Run a restore once it is this process's turn, then with --settle wait for the windows it
+ * moved to settle and report on them.
+ * @param session i3 socket path
+ * @param key identity of the restore, see flightKey()
+ * @return the result of restore.
+ */
+size_t restoreAndSettle(i3ipc::connection &i3conn, const CommandLineOptions &opts, const string &session,
+                        const string &key, const function<size_t()> &restore) {
+    size_t failures;
+    if (!takeTurn(opts, session, key, failures)) return failures;
+
+    unique_ptr<SettleMonitor> settle;
+    if (opts.settleQuietMs > 0 && !opts.dryRun) settle.reset(new SettleMonitor(i3conn));
+
+    failures = restore();
+    finishFlight(failures);
+
+    if (settle) {
+        settle->restoreDone();
+        // Applications are waited for, not i3.
+        stopDeadlines();
+        settle->wait(opts.settleQuietMs);
+        settle->report(cout);
+    }
 
-            std::stringstream escapedWorkspaceName;
-            escapedWorkspaceName << std::quoted(workspaceName);
+    return failures;
+}
 
-            if (!moveWindow(i3connection, windowId, outputName, escapedWorkspaceName.str(), workspaceId, windowName, opts)) {
-                cerr << "Failed to move " << windowId << " (" << windowName << ")." << endl;
+/**
+ * Send output to stdout, or with --out build it in memory and replace the file at once.
+ */
+void writeOutput(const CommandLineOptions &opts, const function<void(ostream &)> &write) {
+    if (opts.outPath.empty()) {
+        write(cout);
+        return;
+    }
 
-                if (opts.failFast) return 1;
-            }
+    ostringstream out;
+    write(out);
+    writeFileAtomically(opts.outPath, out.str(), opts.fsyncOut);
+}
+
+/**
+ * Mode of a run, recorded in the event log.
+ */
+enum RunMode {
+    MODE_CAPTURE, MODE_PLAN, MODE_LAZY, MODE_RESTORE, MODE_SERVICE, MODE_RULES, MODE_SCRIPT, MODE_UNMARK, MODE_RESIDENT, MODE_MERGE
+};
+
+int run(const CommandLineOptions &opts) {
+    if (!opts.servicePath.empty()) {
+        logEvent(EV_START, 0, MODE_SERVICE, 0);
+        return runService(opts.servicePath, opts);
+    }
+
+    if (!opts.mergePaths.empty()) {
+        // Merging only reads files, i3 is not needed.
+        logEvent(EV_START, 0, MODE_MERGE, 0);
+        size_t conflicts;
+        Snapshot merged = mergeSnapshots(readSnapshotFiles(opts.mergePaths), opts.mergePolicy,
+                                         opts.windowIdentifier, conflicts);
+        writeOutput(opts, [&](ostream &out) { writeSnapshot(out, merged, opts.encodeStrings); });
+        if (conflicts > 0) cerr << conflicts << " duplicate records placed a window differently." << endl;
+        return 0;
+    }
+
+    if (opts.resident) {
+        logEvent(EV_START, 0, MODE_RESIDENT, 0);
+        return runResident(opts);
+    }
+
+    beginPhase("connect");
+    string session = opts.socketPath.empty() ? i3ipc::get_socketpath() : opts.socketPath;
+    i3ipc::connection i3connection(session);
+    watchSocket(i3connection.get_main_socket_fd());
+
+    if (opts.script) {
+        logEvent(EV_START, 0, MODE_SCRIPT, 0);
+        vector<string> operations = opts.scriptOperations.empty() ? readScript(cin) : opts.scriptOperations;
+        return runScript(i3connection, operations, opts) > 0 ? 1 : 0;
+    }
+
+    if (opts.unmark) {
+        logEvent(EV_START, 0, MODE_UNMARK, 0);
+        return unmarkWindows(i3connection, opts) > 0 ? 1 : 0;
+    }
+
+    bool capture = opts.forceOutputMode || !opts.outPath.empty() || !inputFromTerminal();
+
+    // Everything but a capture reads stdin, whole so that identical restores are recognized.
+    stringstream input;
+    if (!capture || (opts.emitRules && !opts.layout)) input << cin.rdbuf();
+    string variant = to_string(opts.failFast) + to_string(opts.windowIdentifier);
+
+    if (capture && opts.layout) {
+        logEvent(EV_START, 0, MODE_CAPTURE, 1);
+        beginPhase("capture");
+        armRequest();
+        LayoutNode layout = captureLayout(*i3connection.get_tree());
+        writeOutput(opts, [&](ostream &out) { writeLayout(out, layout); });
+    } else if (capture && !opts.emitRules) {
+        logEvent(EV_START, 0, MODE_CAPTURE, 0);
+        TreeStats stats;
+        Snapshot snapshot = captureSnapshot(i3connection, opts.marks, opts.treeStats ? &stats : nullptr);
+        // Marks go on before the snapshot referring to them is written.
+        if (opts.marks && markWindows(i3connection, snapshot, opts) > 0) return 1;
+
+        // With --tree-stats the snapshot is only written to a file given with --out.
+        if (!opts.treeStats || !opts.outPath.empty())
+            writeOutput(opts, [&](ostream &out) { writeSnapshot(out, snapshot, opts.encodeStrings); });
+        if (opts.treeStats) writeTreeStats(cout, stats);
+    } else if (!opts.emitRules && readLayoutHeader(input)) {
+        LayoutNode saved = readLayout(input);
+
+        if (opts.printPlan || opts.planScript) {
+            logEvent(EV_START, 0, MODE_PLAN, 1);
+            RestorePlan plan = planLayoutRestore(i3connection, saved, opts);
+
+            if (opts.printPlan) printPlan(cout, plan);
+            if (opts.planScript) writePlanScript(cout, plan);
+        } else {
+            // Layout edits depend on each other, so they are not deferred by --lazy.
+            logEvent(EV_START, 0, MODE_RESTORE, 1);
+            // Layout snapshots do not record outputs; only wait for them to stop changing.
+            awaitOutputs(i3connection, opts, set<string>());
+            string key = flightKey(input.str(), "layout" + variant);
+            size_t failures = restoreAndSettle(i3connection, opts, session, key, [&]() {
+                return restoreLayout(i3connection, saved, opts);
+            });
+            if (failures > 0 && opts.failFast) return 1;
         }
+    } else if (opts.emitRules) {
+        logEvent(EV_START, 0, MODE_RULES, 0);
+        Snapshot saved = readSnapshot(input);
+
+        beginPhase("fetch");
+        armRequest();
+        auto tree = i3connection.get_tree();
+        ConIndex live(*tree);
+
+        size_t missing;
+        vector<WindowRule> rules = buildRules(saved, live, opts.windowIdentifier, missing);
+        writeOutput(opts, [&](ostream &out) { writeRules(out, rules); });
+        if (missing > 0) cerr << missing << " windows were not found or have no class." << endl;
+    } else if (opts.printPlan || opts.planScript) {
+        logEvent(EV_START, 0, MODE_PLAN, 0);
+        RestorePlan plan = planRestore(i3connection, readSnapshot(input), opts);
+
+        if (opts.printPlan) printPlan(cout, plan);
+        if (opts.planScript) writePlanScript(cout, plan);
+    } else if (opts.lazy) {
+        logEvent(EV_START, 0, MODE_LAZY, 0);
+        Snapshot saved = readSnapshot(input);
+        awaitOutputs(i3connection, opts, snapshotOutputs(saved));
+
+        size_t failures;
+        if (takeTurn(opts, session, flightKey(input.str(), "lazy" + variant), failures)) {
+            RestorePlan plan = planRestore(i3connection, saved, opts);
+            // A detached restore of hidden workspaces gives up its turn here; a newer restore
+            // still stops it.
+            failures = restoreLazily(i3connection, plan, opts, opts.lazyIdleMs, !opts.debug);
+            finishFlight(failures);
+        }
+        if (failures > 0 && opts.failFast) return 1;
+    } else {
+        logEvent(EV_START, 0, MODE_RESTORE, 0);
+        Snapshot saved = readSnapshot(input);
+        awaitOutputs(i3connection, opts, snapshotOutputs(saved));
+        string key = flightKey(input.str(), "restore" + variant);
+        size_t failures = restoreAndSettle(i3connection, opts, session, key, [&]() {
+            return restoreSnapshot(i3connection, saved, opts);
+        });
+        if (failures > 0 && opts.failFast) return 1;
     }
 
     return 0;
 }
+
+int main(int argc, char **argv) {
+    CommandLineOptions opts = parseOptions(argc, argv);
+    installEventLogSignalHandlers();
+    // The service and resident mode run indefinitely; their phase and request limits apply per request.
+    bool indefinite = !opts.servicePath.empty() || opts.resident;
+    startDeadlines(DeadlineBudget{indefinite ? 0 : opts.runTimeoutMs, opts.phaseTimeoutMs,
+                                  opts.requestTimeoutMs});
+
+    int status;
+    try {
+        status = run(opts);
+    } catch (const DeadlineExceeded &e) {
+        logEvent(EV_ERROR, 0, 0, 0, e.what(), strlen(e.what()));
+        reportTimeout("timed out");
+        status = EXIT_TIMEOUT;
+    } catch (const exception &e) {
+        logEvent(EV_ERROR, 0, 0, 0, e.what(), strlen(e.what()));
+        if (requestTimedOut()) {
+            reportTimeout("request timed out");
+            status = EXIT_TIMEOUT;
+        } else {
+            cerr << e.what() << endl;
+            status = 1;
+        }
+    }
+    stopDeadlines();
+
+    if (status != 0) dumpEventLog(STDERR_FILENO);
+
+    if (!opts.eventLogPath.empty()) {
+        int fd = open(opts.eventLogPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd >= 0) {
+            dumpEventLog(fd);
+            close(fd);
+        } else {
+            cerr << "Unable to write event log to " << opts.eventLogPath << ": " << strerror(errno) << endl;
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,187 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "merge.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unordered_map>
+
+#include "con_index.h"
+#include "layout.h"
+
+using namespace std;
+
+vector<Snapshot> readSnapshotFiles(const vector<string> &paths) {
+    vector<pair<struct timespec, size_t>> order;
+    order.reserve(paths.size());
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        struct stat info{};
+        if (stat(paths[i].c_str(), &info) != 0) throw runtime_error("Unable to read " + paths[i]);
+        order.emplace_back(info.st_mtim, i);
+    }
+
+    stable_sort(order.begin(), order.end(), [](const pair<struct timespec, size_t> &a,
+                                               const pair<struct timespec, size_t> &b) {
+        if (a.first.tv_sec != b.first.tv_sec) return a.first.tv_sec < b.first.tv_sec;
+        return a.first.tv_nsec < b.first.tv_nsec;
+    });
+
+    vector<Snapshot> snapshots;
+    snapshots.reserve(paths.size());
+
+    for (auto &entry : order) {
+        const string &path = paths[entry.second];
+        ifstream in(path);
+        if (!in) throw runtime_error("Unable to read " + path);
+        // Containers have no identity across layout snapshots to join them by.
+        if (readLayoutHeader(in)) throw runtime_error("Cannot merge full-layout snapshot " + path);
+        snapshots.push_back(readSnapshot(in));
+    }
+
+    return snapshots;
+}
+
+static bool samePlacement(const WindowRecord &a, const WindowRecord &b) {
+    return a.outputName == b.outputName && a.workspaceName == b.workspaceName && a.placement == b.placement;
+}
+
+/**
+ * Window identity of merged records.  A record is known by the X window of its mark and
+ * by its con_id, or title with WINDOW_TITLE, and all keys it has lead to the same merged
+ * record.  So a marked and an unmarked record of one window are joined through their
+ * con_id, while two marked records only join if their marks agree.
+ */
+class RecordKeys {
+public:
+    RecordKeys(const Snapshot &merged, WindowIdentifier identifier, size_t expected)
+            : merged(merged), byTitle(identifier == WINDOW_TITLE), byXWindow(expected), byId(byTitle ? 0 : expected) {
+        if (byTitle) titles.reserve(expected);
+    }
+
+    /**
+     * @return the position of the merged record of the window of record, or FlatIdMap::NOT_FOUND.
+     */
+    uint32_t find(const WindowRecord &record) const {
+        uint32_t position = record.mark.empty() ? FlatIdMap::NOT_FOUND : byXWindow.find(markedXWindow(record.mark));
+        if (position != FlatIdMap::NOT_FOUND) return position;
+
+        if (!byTitle) {
+            position = byId.find(record.windowId);
+        } else {
+            auto found = titles.find(record.windowName);
+            if (found != titles.end()) position = found->second;
+        }
+
+        // Differently marked windows are different windows, whatever their con_ids.
+        if (position != FlatIdMap::NOT_FOUND && !record.mark.empty() && !merged[position].mark.empty())
+            return FlatIdMap::NOT_FOUND;
+        return position;
+    }
+
+    /**
+     * Let every key of record lead to position, unless it already leads to another record.
+     */
+    void insert(const WindowRecord &record, uint32_t position) {
+        if (!record.mark.empty()) addKey(byXWindow, markedXWindow(record.mark), position);
+
+        if (!byTitle) addKey(byId, record.windowId, position);
+        else titles.emplace(record.windowName, position);
+    }
+
+private:
+    static void addKey(FlatIdMap &keys, uint64_t key, uint32_t position) {
+        if (keys.find(key) == FlatIdMap::NOT_FOUND) keys.insert(key, position);
+    }
+
+    const Snapshot &merged;
+    bool byTitle;
+    FlatIdMap byXWindow;
+    FlatIdMap byId;
+    unordered_map<string, uint32_t> titles;
+};
+
+Snapshot mergeSnapshots(const vector<Snapshot> &snapshots, MergePolicy policy, WindowIdentifier identifier,
+                        size_t &conflicts) {
+    size_t total = 0;
+    for (auto &snapshot : snapshots) total += snapshot.size();
+
+    // The most recent snapshot with windows on each output owns it.
+    unordered_map<string, size_t> owners;
+    if (policy == MERGE_OUTPUT_OWNER)
+        for (size_t i = 0; i < snapshots.size(); i++)
+            for (auto &record : snapshots[i])
+                owners[record.outputName] = i;
+
+    auto owns = [&](size_t source, const WindowRecord &record) {
+        auto owner = owners.find(record.outputName);
+        return owner != owners.end() && owner->second == source;
+    };
+
+    Snapshot merged;
+    merged.reserve(total);
+    // Snapshot each merged record came from.
+    vector<size_t> sources;
+    sources.reserve(total);
+    RecordKeys keys(merged, identifier, total);
+    conflicts = 0;
+
+    for (size_t i = 0; i < snapshots.size(); i++) {
+        for (auto &record : snapshots[i]) {
+            uint32_t position = keys.find(record);
+            if (position == FlatIdMap::NOT_FOUND) {
+                keys.insert(record, static_cast<uint32_t>(merged.size()));
+                merged.push_back(record);
+                sources.push_back(i);
+                continue;
+            }
+
+            keys.insert(record, position);
+
+            WindowRecord &kept = merged[position];
+            if (!samePlacement(kept, record)) conflicts++;
+
+            // Snapshots come oldest first, so the newer record wins unless only the older
+            // one lies on an output its snapshot owns.
+            if (owns(sources[position], kept) && !owns(i, record)) continue;
+
+            // A mark outlives con_ids, keep it for the records that come without one.
+            string mark = move(kept.mark);
+            kept = record;
+            if (kept.mark.empty()) kept.mark = move(mark);
+            sources[position] = i;
+        }
+    }
+
+    return merged;
+}
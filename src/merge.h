@@ -0,0 +1,60 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_MERGE_H
+#define I3_SNAPSHOT_MERGE_H
+
+#include <string>
+#include <vector>
+
+#include "snapshot.h"
+
+/**
+ * Read snapshot files to merge, oldest first by modification time.  Files modified at the
+ * same time keep their order.
+ * @param paths snapshot files
+ * @throws std::runtime_error if a file cannot be read or is a full-layout snapshot.
+ */
+std::vector<Snapshot> readSnapshotFiles(const std::vector<std::string> &paths);
+
+/**
+ * Combine snapshots into one holding each window once.  Records are joined by window
+ * identity: the snapshot mark or the con_id, or the title with WINDOW_TITLE, whichever
+ * the records share.  This is a single hash join, linear in the total number of records.
+ * @param snapshots snapshots, oldest first
+ * @param policy picks the record of a window placed by several snapshots
+ * @param identifier how windows without a mark are identified
+ * @param conflicts receives the number of duplicate records placing a window differently
+ * @return one record per window, in order of first appearance.
+ */
+Snapshot mergeSnapshots(const std::vector<Snapshot> &snapshots, MergePolicy policy, WindowIdentifier identifier,
+                        size_t &conflicts);
+
+#endif //I3_SNAPSHOT_MERGE_H
@@ -0,0 +1,381 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "persistent_snapshot.h"
+
+#include <algorithm>
+
+#include "con_index.h"
+
+using namespace std;
+
+typedef PersistentSnapshot::Node Node;
+typedef PersistentSnapshot::Leaf Leaf;
+
+/**
+ * Bits of the hash consumed per level, 32 children per node.  Window ids are mixed with
+ * a bijection, so two windows always differ within the 64 bits and never collide.
+ */
+static const unsigned LEVEL_BITS = 5;
+static const uint64_t LEVEL_MASK = (1u << LEVEL_BITS) - 1;
+
+struct PersistentSnapshot::Leaf {
+    uint64_t hash;
+    SharedRecord record;
+};
+
+/**
+ * Child of a node: either a subtree or a single record.
+ */
+struct Slot {
+    shared_ptr<const Node> node;
+    shared_ptr<const Leaf> leaf;
+};
+
+struct PersistentSnapshot::Node {
+    uint32_t bitmap{};
+    vector<Slot> slots;
+};
+
+InternedString StringPool::intern(const string &value) {
+    auto found = strings.find(string_view(value));
+    if (found != strings.end()) return found->second;
+
+    auto pooled = make_shared<const string>(value);
+    strings.emplace(string_view(*pooled), pooled);
+    return pooled;
+}
+
+size_t StringPool::collect() {
+    size_t dropped = 0;
+
+    for (auto it = strings.begin(); it != strings.end();) {
+        if (it->second.use_count() == 1) {
+            it = strings.erase(it);
+            dropped++;
+        } else {
+            ++it;
+        }
+    }
+
+    return dropped;
+}
+
+WindowRecord SharedRecord::toRecord() const {
+    WindowRecord record;
+    record.outputName = *outputName;
+    record.workspaceName = *workspaceName;
+    record.workspaceId = workspaceId;
+    record.windowId = windowId;
+    record.windowName = *windowName;
+    record.placement = placement;
+    record.mark = *mark;
+    return record;
+}
+
+/**
+ * @return true if the shared record holds the same values as a plain one.
+ */
+static bool sameValues(const SharedRecord &shared, const WindowRecord &record) {
+    return shared.workspaceId == record.workspaceId && *shared.outputName == record.outputName &&
+           *shared.workspaceName == record.workspaceName && *shared.windowName == record.windowName &&
+           shared.placement == record.placement && *shared.mark == record.mark;
+}
+
+static SharedRecord share(const WindowRecord &record, StringPool &pool, size_t order) {
+    SharedRecord shared;
+    shared.outputName = pool.intern(record.outputName);
+    shared.workspaceName = pool.intern(record.workspaceName);
+    shared.workspaceId = record.workspaceId;
+    shared.windowId = record.windowId;
+    shared.windowName = pool.intern(record.windowName);
+    shared.placement = record.placement;
+    shared.mark = pool.intern(record.mark);
+    shared.order = order;
+    return shared;
+}
+
+static unsigned slotIndex(uint64_t hash, unsigned shift) {
+    return static_cast<unsigned>((hash >> shift) & LEVEL_MASK);
+}
+
+static size_t slotPosition(uint32_t bitmap, uint32_t bit) {
+    return static_cast<size_t>(__builtin_popcount(bitmap & (bit - 1)));
+}
+
+/**
+ * Copy the path to the leaf's position and put the leaf there.
+ * @param added set if the window was not present before.
+ */
+static shared_ptr<const Node> insertLeaf(const Node *node, unsigned shift, const shared_ptr<const Leaf> &leaf,
+                                         bool &added) {
+    auto copy = node != nullptr ? make_shared<Node>(*node) : make_shared<Node>();
+    uint32_t bit = 1u << slotIndex(leaf->hash, shift);
+    size_t position = slotPosition(copy->bitmap, bit);
+
+    if ((copy->bitmap & bit) == 0) {
+        copy->bitmap |= bit;
+        copy->slots.insert(copy->slots.begin() + position, Slot{nullptr, leaf});
+        added = true;
+        return copy;
+    }
+
+    Slot &slot = copy->slots[position];
+    if (slot.node != nullptr) {
+        slot.node = insertLeaf(slot.node.get(), shift + LEVEL_BITS, leaf, added);
+    } else if (slot.leaf->record.windowId == leaf->record.windowId) {
+        slot.leaf = leaf;
+    } else {
+        // Two windows share the prefix so far: push both one level down.
+        bool ignored = false;
+        auto split = insertLeaf(nullptr, shift + LEVEL_BITS, slot.leaf, ignored);
+        slot = Slot{insertLeaf(split.get(), shift + LEVEL_BITS, leaf, added), nullptr};
+    }
+
+    return copy;
+}
+
+/**
+ * @return the node without the window, the same node if it is absent, or nullptr once
+ * the node is empty.
+ */
+static shared_ptr<const Node> eraseLeaf(const shared_ptr<const Node> &node, unsigned shift, uint64_t hash,
+                                        size_t windowId, bool &removed) {
+    uint32_t bit = 1u << slotIndex(hash, shift);
+    if ((node->bitmap & bit) == 0) return node;
+
+    size_t position = slotPosition(node->bitmap, bit);
+    const Slot &slot = node->slots[position];
+    shared_ptr<const Node> child;
+
+    if (slot.node != nullptr) {
+        child = eraseLeaf(slot.node, shift + LEVEL_BITS, hash, windowId, removed);
+        if (!removed) return node;
+    } else if (slot.leaf->record.windowId != windowId) {
+        return node;
+    } else {
+        removed = true;
+    }
+
+    auto copy = make_shared<Node>(*node);
+    if (child == nullptr) {
+        copy->bitmap &= ~bit;
+        copy->slots.erase(copy->slots.begin() + position);
+        if (copy->slots.empty()) return nullptr;
+    } else if (child->slots.size() == 1 && child->slots[0].leaf != nullptr) {
+        // Keep the trie canonical: a lone record moves back up.
+        copy->slots[position] = child->slots[0];
+    } else {
+        copy->slots[position].node = child;
+    }
+
+    return copy;
+}
+
+static void forEachLeaf(const Slot &slot, const function<void(const SharedRecord &)> &visit) {
+    if (slot.leaf != nullptr) {
+        visit(slot.leaf->record);
+        return;
+    }
+
+    for (auto &child : slot.node->slots) forEachLeaf(child, visit);
+}
+
+/**
+ * Build a subtree from leaves sorted by hash that share the bits above shift.
+ */
+static shared_ptr<const Node> buildNode(vector<shared_ptr<const Leaf>>::const_iterator begin,
+                                        vector<shared_ptr<const Leaf>>::const_iterator end, unsigned shift) {
+    auto node = make_shared<Node>();
+
+    while (begin != end) {
+        unsigned index = slotIndex((*begin)->hash, shift);
+        auto group = begin;
+        while (group != end && slotIndex((*group)->hash, shift) == index) ++group;
+
+        node->bitmap |= 1u << index;
+        if (group - begin == 1) node->slots.push_back(Slot{nullptr, *begin});
+        else node->slots.push_back(Slot{buildNode(begin, group, shift + LEVEL_BITS), nullptr});
+        begin = group;
+    }
+
+    return node;
+}
+
+/**
+ * @return the order of hashes in the trie: by slot index at each level, low bits first.
+ */
+static uint64_t trieOrder(uint64_t hash) {
+    uint64_t reversed = 0;
+    for (unsigned shift = 0; shift < 64; shift += LEVEL_BITS) {
+        unsigned width = shift + LEVEL_BITS <= 64 ? LEVEL_BITS : 64 - shift;
+        reversed = (reversed << width) | ((hash >> shift) & ((1u << width) - 1));
+    }
+    return reversed;
+}
+
+PersistentSnapshot PersistentSnapshot::fromSnapshot(const Snapshot &snapshot, StringPool &pool) {
+    // Built bottom-up in one pass rather than by path copying each insert.
+    vector<shared_ptr<const Leaf>> leaves;
+    leaves.reserve(snapshot.size());
+    FlatIdMap seen(snapshot.size());
+
+    for (auto &record : snapshot) {
+        if (seen.find(record.windowId) != FlatIdMap::NOT_FOUND) continue;
+        seen.insert(record.windowId, 0);
+
+        leaves.push_back(make_shared<const Leaf>(Leaf{FlatIdMap::hash(record.windowId),
+                                                      share(record, pool, leaves.size())}));
+    }
+
+    vector<pair<uint64_t, size_t>> positions;
+    positions.reserve(leaves.size());
+    for (size_t i = 0; i < leaves.size(); i++) positions.emplace_back(trieOrder(leaves[i]->hash), i);
+    sort(positions.begin(), positions.end());
+
+    vector<shared_ptr<const Leaf>> sorted;
+    sorted.reserve(leaves.size());
+    for (auto &position : positions) sorted.push_back(move(leaves[position.second]));
+    leaves.swap(sorted);
+
+    PersistentSnapshot built;
+    if (!leaves.empty()) built.root = buildNode(leaves.begin(), leaves.end(), 0);
+    built.count = leaves.size();
+    built.nextOrder = leaves.size();
+
+    return built;
+}
+
+PersistentSnapshot PersistentSnapshot::update(const Snapshot &live, StringPool &pool) const {
+    if (empty()) return fromSnapshot(live, pool);
+
+    PersistentSnapshot next = *this;
+    size_t present = 0;
+
+    for (auto &record : live) {
+        const SharedRecord *old = find(record.windowId);
+        if (old != nullptr) present++;
+        if (old != nullptr && sameValues(*old, record)) continue;
+
+        next = next.set(share(record, pool, old != nullptr ? old->order : next.nextOrder));
+    }
+
+    // Windows of this snapshot missing from the capture were closed.
+    if (present < count) {
+        FlatIdMap seen(live.size());
+        for (auto &record : live) seen.insert(record.windowId, 0);
+
+        forEach([&next, &seen](const SharedRecord &record) {
+            if (seen.find(record.windowId) == FlatIdMap::NOT_FOUND) next = next.erase(record.windowId);
+        });
+    }
+
+    return next;
+}
+
+PersistentSnapshot PersistentSnapshot::set(const SharedRecord &record) const {
+    auto leaf = make_shared<const Leaf>(Leaf{FlatIdMap::hash(record.windowId), record});
+    bool added = false;
+
+    PersistentSnapshot next = *this;
+    next.root = insertLeaf(root.get(), 0, leaf, added);
+    if (added) next.count++;
+    next.nextOrder = max(nextOrder, record.order + 1);
+
+    return next;
+}
+
+PersistentSnapshot PersistentSnapshot::erase(size_t windowId) const {
+    if (root == nullptr) return *this;
+
+    bool removed = false;
+    PersistentSnapshot next = *this;
+    next.root = eraseLeaf(root, 0, FlatIdMap::hash(windowId), windowId, removed);
+    if (removed) next.count--;
+
+    return next;
+}
+
+const SharedRecord *PersistentSnapshot::find(size_t windowId) const {
+    uint64_t hash = FlatIdMap::hash(windowId);
+    const Node *node = root.get();
+
+    for (unsigned shift = 0; node != nullptr; shift += LEVEL_BITS) {
+        uint32_t bit = 1u << slotIndex(hash, shift);
+        if ((node->bitmap & bit) == 0) return nullptr;
+
+        const Slot &slot = node->slots[slotPosition(node->bitmap, bit)];
+        if (slot.leaf != nullptr) return slot.leaf->record.windowId == windowId ? &slot.leaf->record : nullptr;
+        node = slot.node.get();
+    }
+
+    return nullptr;
+}
+
+void PersistentSnapshot::forEach(const function<void(const SharedRecord &)> &visit) const {
+    if (root != nullptr) forEachLeaf(Slot{root, nullptr}, visit);
+}
+
+Snapshot PersistentSnapshot::toSnapshot() const {
+    vector<const SharedRecord *> ordered;
+    ordered.reserve(count);
+    forEach([&ordered](const SharedRecord &record) { ordered.push_back(&record); });
+
+    sort(ordered.begin(), ordered.end(), [](const SharedRecord *a, const SharedRecord *b) {
+        return a->order < b->order;
+    });
+
+    Snapshot snapshot;
+    snapshot.reserve(ordered.size());
+    for (auto record : ordered) snapshot.push_back(record->toRecord());
+
+    return snapshot;
+}
+
+const PersistentSnapshot &SnapshotStore::save(const string &name, const Snapshot &live) {
+    latest = latest.update(live, pool);
+    PersistentSnapshot &stored = slots[name] = latest;
+
+    // Strings only the replaced snapshot used.
+    pool.collect();
+    return stored;
+}
+
+const PersistentSnapshot *SnapshotStore::load(const string &name) const {
+    auto found = slots.find(name);
+    return found == slots.end() ? nullptr : &found->second;
+}
+
+bool SnapshotStore::remove(const string &name) {
+    if (slots.erase(name) == 0) return false;
+
+    if (slots.empty()) latest = PersistentSnapshot();
+    return true;
+}
@@ -0,0 +1,171 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_PERSISTENT_SNAPSHOT_H
+#define I3_SNAPSHOT_PERSISTENT_SNAPSHOT_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "snapshot.h"
+
+typedef std::shared_ptr<const std::string> InternedString;
+
+/**
+ * Table of shared immutable strings, so that snapshots holding the same output, workspace
+ * or window name share one copy.  Not thread safe.
+ */
+class StringPool {
+public:
+    /**
+     * @return the pooled copy of value.
+     */
+    InternedString intern(const std::string &value);
+
+    /**
+     * Drop strings no longer referred to by any snapshot.
+     * @return number of strings dropped.
+     */
+    size_t collect();
+
+    size_t size() const { return strings.size(); }
+
+private:
+    std::unordered_map<std::string_view, InternedString> strings;
+};
+
+/**
+ * A WindowRecord whose strings are interned.
+ */
+struct SharedRecord {
+    InternedString outputName;
+    InternedString workspaceName;
+    size_t workspaceId{};
+    size_t windowId{};
+    InternedString windowName;
+    WindowPlacement placement{PLACEMENT_TILING};
+    InternedString mark;
+    // Position of the window when it was first recorded, to write snapshots in tree order.
+    size_t order{};
+
+    WindowRecord toRecord() const;
+};
+
+/**
+ * Immutable snapshot stored in a hash array mapped trie keyed by window id.  update()
+ * returns a new snapshot sharing all unchanged nodes with the old one, so consecutive
+ * captures kept side by side cost memory in proportion to what changed between them.
+ * Copies are cheap.
+ */
+class PersistentSnapshot {
+public:
+    /**
+     * Build a snapshot from records in tree order.
+     */
+    static PersistentSnapshot fromSnapshot(const Snapshot &snapshot, StringPool &pool);
+
+    /**
+     * Derive the snapshot of a newly captured tree from this one, touching only the
+     * windows that were added, removed or placed differently.
+     * @param live records of the new capture
+     * @param pool pool this snapshot was built from
+     */
+    PersistentSnapshot update(const Snapshot &live, StringPool &pool) const;
+
+    /**
+     * @return the record of the window, or nullptr.
+     */
+    const SharedRecord *find(size_t windowId) const;
+
+    size_t size() const { return count; }
+
+    bool empty() const { return count == 0; }
+
+    /**
+     * @return the records in the order they were first recorded.
+     */
+    Snapshot toSnapshot() const;
+
+    struct Node;
+    struct Leaf;
+
+private:
+    /**
+     * @return a snapshot with the record of record.windowId replaced or added.
+     */
+    PersistentSnapshot set(const SharedRecord &record) const;
+
+    /**
+     * @return a snapshot without the window, or this one if it is absent.
+     */
+    PersistentSnapshot erase(size_t windowId) const;
+
+    /**
+     * Call visit for every record, in no particular order.
+     */
+    void forEach(const std::function<void(const SharedRecord &)> &visit) const;
+
+    std::shared_ptr<const Node> root;
+    size_t count{};
+    size_t nextOrder{};
+};
+
+/**
+ * Named snapshots kept in memory.
+ */
+class SnapshotStore {
+public:
+    /**
+     * Store a capture under name, replacing what was there.  It is built on the previous
+     * capture saved under any name, so that the two share structure.
+     * @return the stored snapshot.
+     */
+    const PersistentSnapshot &save(const std::string &name, const Snapshot &live);
+
+    /**
+     * @return the snapshot saved under name, or nullptr.
+     */
+    const PersistentSnapshot *load(const std::string &name) const;
+
+    bool remove(const std::string &name);
+
+    StringPool &strings() { return pool; }
+
+private:
+    PersistentSnapshot latest;
+    std::map<std::string, PersistentSnapshot> slots;
+    StringPool pool;
+};
+
+#endif //I3_SNAPSHOT_PERSISTENT_SNAPSHOT_H
@@ -0,0 +1,615 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "plan.h"
+
+#include "deadline.h"
+#include "event_log.h"
+#include "ipc_command.h"
+#include "prefetch.h"
+#include "rules.h"
+#include "single_flight.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+size_t RestorePlan::commandCount() const {
+    size_t count = 0;
+    for (auto &batch : batches) count += batch.steps.size();
+    return count;
+}
+
+static string quoteName(const string &name) {
+    stringstream quoted;
+    quoted << std::quoted(name);
+    return quoted.str();
+}
+
+/**
+ * @return criteria selecting the window of a record: its snapshot mark if it has one,
+ * which survives i3 restarts, else con_id or title as chosen by the options.
+ */
+static string windowCriteria(const WindowRecord &record, const CommandLineOptions &opts) {
+    // https://build.i3wm.org/docs/userguide.html#command_criteria
+    if (!record.mark.empty()) return "[con_mark=\"^" + record.mark + "$\"]";
+    if (opts.windowIdentifier == I3_ID) return "[con_id=" + to_string(record.windowId) + "]";
+
+    return "[title=" + quoteName(record.windowName) + "]";
+}
+
+/**
+ * Command moving the workspace of a record to its output.
+ * @param workspace the live workspace, or nullptr if the window moves create it.
+ */
+static string workspaceMoveCommand(const WindowRecord &record, const LiveWorkspace *workspace,
+                                   const CommandLineOptions &opts) {
+    // Names such as " 2 <span foreground='#2aa198'></span> " change with their windows and are
+    // regular expressions in [workspace=...] criteria, so never address a workspace by name.
+    if (workspace != nullptr)
+        return "[con_id=" + to_string(workspace->id) + "] move workspace to output " + record.outputName;
+
+    // Criteria matching a window move the workspace containing it.
+    return windowCriteria(record, opts) + " move workspace to output " + record.outputName;
+}
+
+/**
+ * Command moving the windows matched by criteria to the workspace of a record.
+ * @param workspace the live workspace, or nullptr to create it under the recorded name.
+ */
+static string moveToWorkspaceCommand(const string &criteria, const WindowRecord &record,
+                                     const LiveWorkspace *workspace) {
+    const string &workspaceName = workspace != nullptr ? workspace->name : record.workspaceName;
+
+    return criteria + " move container to workspace " + quoteName(workspaceName);
+}
+
+/**
+ * Command moving the window of a record to its workspace.
+ * @param workspace the live workspace, or nullptr to create it under the recorded name.
+ */
+static string windowMoveCommand(const WindowRecord &record, const LiveWorkspace *workspace,
+                                const CommandLineOptions &opts) {
+    return moveToWorkspaceCommand(windowCriteria(record, opts), record, workspace);
+}
+
+/**
+ * Command sending the window of a record to the scratchpad.
+ */
+static string scratchpadMoveCommand(const WindowRecord &record, const CommandLineOptions &opts) {
+    return windowCriteria(record, opts) + " move scratchpad";
+}
+
+void appendStep(RestorePlan &plan, PlanStep &&step, PlanPriority priority) {
+    size_t bytes = step.command.size() + 2;
+
+    if (plan.batches.empty() || plan.batches.back().priority != priority ||
+        plan.batches.back().steps.size() >= MAX_BATCH_COMMANDS ||
+        plan.batches.back().bytes + bytes > MAX_BATCH_BYTES) {
+        plan.batches.emplace_back();
+        plan.batches.back().priority = priority;
+    }
+
+    plan.batches.back().bytes += bytes;
+    plan.batches.back().steps.push_back(move(step));
+}
+
+/**
+ * Pending commands for one target workspace.
+ */
+struct WorkspaceGroup {
+    const WindowRecord *first;
+    const LiveWorkspace *workspace;
+    size_t firstLine;
+    vector<PlanStep> windowSteps;
+    // Live window moved by each of windowSteps.
+    vector<const ConRecord *> movedWindows;
+    PlanPriority priority;
+};
+
+/**
+ * Criteria that select several windows at once, coarsest first: class, class and instance,
+ * class and workspace, all three.
+ */
+const int CRITERIA_LEVELS = 4;
+
+static bool levelHasInstance(int level) {
+    return level == 1 || level == 3;
+}
+
+static bool levelHasWorkspace(int level) {
+    return level >= 2;
+}
+
+/**
+ * Number of live windows matched by each class, instance and workspace criteria, so that
+ * moves of all windows a criteria matches can be replaced by a single command.
+ */
+class CriteriaIndex {
+public:
+    explicit CriteriaIndex(const ConIndex &live) : live(live) {
+        for (auto &con : live.all()) {
+            if (!isWindow(*con.container)) continue;
+
+            for (int level = 0; level < CRITERIA_LEVELS; level++) {
+                string key = keyOf(con, level);
+                if (!key.empty()) windows[key]++;
+            }
+        }
+    }
+
+    /**
+     * @return identity of the criteria of window at level, empty if the window lacks a
+     * property the level needs.
+     */
+    string keyOf(const ConRecord &window, int level) const {
+        string windowClass = windowProperty(*window.container, "class");
+        if (windowClass.empty()) return "";
+
+        string key = to_string(level) + '\x1f' + windowClass;
+        if (levelHasInstance(level)) {
+            string instance = windowProperty(*window.container, "instance");
+            if (instance.empty()) return "";
+            key += '\x1f' + instance;
+        }
+        if (levelHasWorkspace(level)) key += '\x1f' + to_string(window.workspace);
+        return key;
+    }
+
+    /**
+     * @return criteria selecting the windows of window's key at level.
+     */
+    string criteriaOf(const ConRecord &window, int level) const {
+        string criteria = "[class=" + criterion(windowProperty(*window.container, "class"));
+        if (levelHasInstance(level)) criteria += " instance=" + criterion(windowProperty(*window.container, "instance"));
+        if (levelHasWorkspace(level))
+            criteria += " workspace=" + criterion(live.at(window.workspace)->container->name);
+        return criteria + "]";
+    }
+
+    size_t count(const string &key) const {
+        auto found = windows.find(key);
+        return found == windows.end() ? 0 : found->second;
+    }
+
+private:
+    const ConIndex &live;
+    unordered_map<string, size_t> windows;
+};
+
+/**
+ * Replace the window moves of a group by as few commands as possible.  Windows whose
+ * class, class and instance, or the same on their workspace, match exactly the windows the
+ * group moves go out as one command per criteria, found greedily from the coarsest.  The
+ * others keep their own command.
+ * @param movesFrom number of planned moves off each live workspace, by ConIndex position
+ * @param targets names of the workspaces windows are moved to
+ */
+static void compressMoves(WorkspaceGroup &group, const CriteriaIndex &criteria,
+                          const unordered_map<uint32_t, size_t> &movesFrom, const unordered_set<string> &targets,
+                          const ConIndex &live) {
+    size_t moves = group.windowSteps.size();
+    if (moves < 2) return;
+
+    unordered_map<uint32_t, size_t> groupMovesFrom;
+    for (auto window : group.movedWindows) groupMovesFrom[window->workspace]++;
+
+    vector<bool> covered(moves);
+    // Commands with workspace criteria run before any other move of the group.
+    vector<PlanStep> byWorkspace;
+    unordered_set<uint32_t> sourcesUsed;
+    vector<PlanStep> steps;
+
+    for (int level = 0; level < CRITERIA_LEVELS; level++) {
+        vector<string> keys;
+        unordered_map<string, vector<size_t>> movesByKey;
+
+        for (size_t i = 0; i < moves; i++) {
+            if (covered[i]) continue;
+
+            string key = criteria.keyOf(*group.movedWindows[i], level);
+            if (key.empty()) continue;
+
+            auto inserted = movesByKey.emplace(key, vector<size_t>());
+            if (inserted.second) keys.push_back(key);
+            inserted.first->second.push_back(i);
+        }
+
+        for (auto &key : keys) {
+            const vector<size_t> &matched = movesByKey[key];
+            if (matched.size() < 2 || criteria.count(key) != matched.size()) continue;
+
+            const ConRecord &window = *group.movedWindows[matched.front()];
+            if (levelHasWorkspace(level)) {
+                // Workspace criteria go by name, which has to hold until the command runs.  Names
+                // may follow the windows on a workspace, so nothing may have moved off or onto it
+                // before: no other group touches it, and the command runs first in this one.
+                if (movesFrom.at(window.workspace) != groupMovesFrom[window.workspace]) continue;
+                if (targets.count(live.at(window.workspace)->container->name) > 0) continue;
+                if (!sourcesUsed.insert(window.workspace).second) continue;
+            }
+
+            PlanStep step{MOVE_WINDOWS,
+                          moveToWorkspaceCommand(criteria.criteriaOf(window, level), *group.first, group.workspace),
+                          group.first->workspaceName, group.windowSteps[matched.front()].line,
+                          group.workspace != nullptr ? group.workspace->id : 0};
+            (levelHasWorkspace(level) ? byWorkspace : steps).push_back(move(step));
+            for (auto i : matched) covered[i] = true;
+        }
+    }
+
+    if (steps.empty() && byWorkspace.empty()) return;
+
+    for (size_t i = 0; i < moves; i++)
+        if (!covered[i]) steps.push_back(move(group.windowSteps[i]));
+
+    auto byLine = [](const PlanStep &a, const PlanStep &b) { return a.line < b.line; };
+    stable_sort(byWorkspace.begin(), byWorkspace.end(), byLine);
+    stable_sort(steps.begin(), steps.end(), byLine);
+    byWorkspace.insert(byWorkspace.end(), make_move_iterator(steps.begin()), make_move_iterator(steps.end()));
+    group.windowSteps = move(byWorkspace);
+}
+
+static const char *priorityName(PlanPriority priority) {
+    switch (priority) {
+        case PRIORITY_FOCUSED:
+            return "focused";
+        case PRIORITY_VISIBLE:
+            return "visible";
+        default:
+            return "hidden";
+    }
+}
+
+PlanPriority workspacePriority(const LiveWorkspace *workspace) {
+    if (workspace == nullptr) return PRIORITY_HIDDEN;
+    if (workspace->focused) return PRIORITY_FOCUSED;
+    if (workspace->visible) return PRIORITY_VISIBLE;
+    return PRIORITY_HIDDEN;
+}
+
+RestorePlan buildPlan(const Snapshot &saved, const ConIndex &live, const WorkspaceIndex &workspaces,
+                      const OutputList &outputs, const CommandLineOptions &opts) {
+    bool byId = opts.windowIdentifier == I3_ID;
+
+    unordered_set<string> activeOutputs;
+    for (auto &output : outputs)
+        if (output->active) activeOutputs.insert(output->name);
+
+    unordered_map<string, const ConRecord *> liveByTitle;
+    if (!byId)
+        for (auto &con : live.all())
+            if (isWindow(*con.container)) liveByTitle.emplace(con.container->name, &con);
+
+    RestorePlan plan;
+    plan.records = saved.size();
+
+    vector<WorkspaceGroup> groups;
+    unordered_map<string, size_t> groupByWorkspace;
+
+    // Planned moves off each live workspace and the workspaces moved to, see compressMoves().
+    unordered_map<uint32_t, size_t> movesFrom;
+    unordered_set<string> targets;
+
+    // Scratchpad windows have no workspace to restore, they all go back after the others.
+    vector<PlanStep> scratchpadSteps;
+    PlanPriority scratchpadPriority = PRIORITY_HIDDEN;
+
+    for (size_t i = 0; i < saved.size(); i++) {
+        const WindowRecord &record = saved[i];
+        size_t line = i + 1;
+
+        const ConRecord *current = nullptr;
+        if (!record.mark.empty()) {
+            // The mark names the X window, con_ids may have changed with an i3 restart.
+            current = live.findByXWindow(markedXWindow(record.mark));
+        } else if (byId) {
+            current = live.find(record.windowId);
+        } else {
+            auto found = liveByTitle.find(record.windowName);
+            if (found != liveByTitle.end()) current = found->second;
+        }
+
+        const ConRecord *currentWorkspace = current != nullptr ? live.at(current->workspace) : nullptr;
+        if (currentWorkspace == nullptr) {
+            plan.missingLines.push_back(line);
+            continue;
+        }
+
+        if (record.placement == PLACEMENT_SCRATCHPAD) {
+            if (currentWorkspace->container->name == SCRATCHPAD_WORKSPACE) {
+                plan.inPlace++;
+                continue;
+            }
+
+            scratchpadSteps.push_back(PlanStep{MOVE_SCRATCHPAD, scratchpadMoveCommand(record, opts),
+                                               SCRATCHPAD_WORKSPACE, line});
+            movesFrom[current->workspace]++;
+            scratchpadPriority = min(scratchpadPriority, workspacePriority(workspaces.findById(currentWorkspace->id)));
+            continue;
+        }
+
+        auto inserted = groupByWorkspace.emplace(record.workspaceName, groups.size());
+        if (inserted.second) {
+            const LiveWorkspace *workspace = workspaces.resolve(record.workspaceId, record.workspaceName);
+            groups.push_back(WorkspaceGroup{&record, workspace, line, {}, {}, workspacePriority(workspace)});
+        }
+        WorkspaceGroup &group = groups[inserted.first->second];
+
+        if (group.workspace == nullptr || currentWorkspace->id != group.workspace->id) {
+            group.windowSteps.push_back(PlanStep{MOVE_WINDOW, windowMoveCommand(record, group.workspace, opts),
+                                                 record.workspaceName, line,
+                                                 group.workspace != nullptr ? group.workspace->id : 0});
+            group.movedWindows.push_back(current);
+            movesFrom[current->workspace]++;
+            targets.insert(group.workspace != nullptr ? group.workspace->name : record.workspaceName);
+            // Taking a window off a visible workspace is as noticeable as adding one.
+            group.priority = min(group.priority, workspacePriority(workspaces.findById(currentWorkspace->id)));
+        } else if (group.workspace->outputName == record.outputName) {
+            plan.inPlace++;
+        }
+    }
+
+    // Only worth indexing the live tree if some group moves several windows.
+    if (any_of(groups.begin(), groups.end(), [](const WorkspaceGroup &group) { return group.windowSteps.size() > 1; })) {
+        CriteriaIndex criteria(live);
+        for (auto &group : groups) compressMoves(group, criteria, movesFrom, targets, live);
+    }
+
+    stable_sort(groups.begin(), groups.end(), [](const WorkspaceGroup &a, const WorkspaceGroup &b) {
+        return a.priority < b.priority;
+    });
+
+    for (auto &group : groups) {
+        const WindowRecord &record = *group.first;
+
+        // Moving a workspace to an output that is gone or disabled can only fail.
+        bool outputActive = activeOutputs.count(record.outputName) > 0;
+        if (!outputActive) plan.inactiveOutputs.insert(record.outputName);
+
+        if (group.workspace != nullptr) {
+            // Workspace exists: put it in place first so windows land on the right output.
+            if (outputActive && group.workspace->outputName != record.outputName)
+                appendStep(plan, PlanStep{MOVE_WORKSPACE, workspaceMoveCommand(record, group.workspace, opts),
+                                          record.workspaceName, group.firstLine, group.workspace->id},
+                           group.priority);
+            for (auto &step : group.windowSteps) appendStep(plan, move(step), group.priority);
+        } else if (!group.windowSteps.empty()) {
+            // Workspace is created by the first window move, only then can it be moved.
+            for (auto &step : group.windowSteps) appendStep(plan, move(step), group.priority);
+            if (outputActive)
+                appendStep(plan, PlanStep{MOVE_WORKSPACE, workspaceMoveCommand(*group.first, nullptr, opts),
+                                          record.workspaceName, group.firstLine}, group.priority);
+        }
+    }
+
+    for (auto &step : scratchpadSteps) appendStep(plan, move(step), scratchpadPriority);
+
+    return plan;
+}
+
+/**
+ * Chain the commands of a batch into one COMMAND payload.
+ */
+static string joinBatch(const PlanBatch &batch) {
+    string payload;
+    payload.reserve(batch.bytes);
+
+    for (auto &step : batch.steps) {
+        if (!payload.empty()) payload += "; ";
+        payload += step.command;
+    }
+
+    return payload;
+}
+
+static function<void()> batchSent;
+
+void onBatchSent(function<void()> hook) {
+    batchSent = move(hook);
+}
+
+static thread_local function<void(const string &)> failureSink;
+
+void onRestoreFailure(function<void(const string &)> sink) {
+    failureSink = move(sink);
+}
+
+static void reportFailure(const string &message) {
+    if (failureSink)
+        failureSink(message);
+    else
+        cerr << message << endl;
+}
+
+size_t executePlan(const i3ipc::connection &i3conn, const RestorePlan &plan, const CommandLineOptions &opts) {
+    size_t failures = 0;
+
+    for (size_t i = 0; i < plan.batches.size(); i++) {
+        const PlanBatch &batch = plan.batches[i];
+        reportProgress(i, plan.batches.size());
+
+        if (opts.debug)
+            for (auto &step : batch.steps) cout << "i3-msg " << step.command << "\n";
+
+        if (opts.dryRun) continue;
+
+        if (flightSuperseded()) {
+            reportFailure("Stopped after " + to_string(i) + " of " + to_string(plan.batches.size())
+                          + " batches, a newer restore was requested.");
+            break;
+        }
+
+        string payload = joinBatch(batch);
+        logEvent(EV_COMMAND, 0, i + 1, payload.size(), payload.data(), payload.size());
+
+        armRequest();
+        uint64_t sentNs = eventClockNs();
+        vector<CommandResult> results = sendCommands(i3conn, payload);
+
+        // i3 stops at a command it cannot parse; those after it did not run either.
+        size_t failed = 0;
+        for (size_t k = 0; k < batch.steps.size(); k++) {
+            if (k < results.size() && results[k].success) continue;
+            failed++;
+
+            string message = "Failed to apply line " + to_string(batch.steps[k].line) + " in batch "
+                             + to_string(i + 1) + " of " + to_string(plan.batches.size());
+            if (k < results.size() && !results[k].error.empty()) message += ": " + results[k].error;
+            reportFailure(message);
+        }
+        logEvent(EV_REPLY, failed == 0, i + 1, (eventClockNs() - sentNs) / 1000);
+        if (batchSent) batchSent();
+
+        failures += failed;
+        if (failed > 0 && opts.failFast) break;
+    }
+    cout.flush();
+
+    return failures;
+}
+
+RestorePlan planRestore(const i3ipc::connection &i3conn, const Snapshot &snapshot, const CommandLineOptions &opts) {
+    beginPhase("fetch");
+    return planRestore(fetchLiveState(i3conn, opts.socketPath), snapshot, opts);
+}
+
+RestorePlan planRestore(const LiveState &state, const Snapshot &snapshot, const CommandLineOptions &opts) {
+    ConIndex live(*state.tree);
+    logEvent(EV_TREE, 0, live.all().size(), state.workspaces.size());
+
+    WorkspaceIndex workspaces(*state.tree, state.workspaces, opts.windowIdentifier == I3_ID);
+
+    RestorePlan plan = buildPlan(snapshot, live, workspaces, state.outputs, opts);
+    logEvent(EV_PLAN, 0, plan.commandCount(), plan.batches.size());
+
+    return plan;
+}
+
+size_t restoreSnapshot(const i3ipc::connection &i3conn, const Snapshot &snapshot, const CommandLineOptions &opts) {
+    return executeRestore(i3conn, snapshot, planRestore(i3conn, snapshot, opts), opts);
+}
+
+size_t executeRestore(const i3ipc::connection &i3conn, const Snapshot &snapshot, const RestorePlan &plan,
+                      const CommandLineOptions &opts) {
+    for (auto line : plan.missingLines)
+        reportFailure("Failed to move " + to_string(snapshot[line - 1].windowId) + " ("
+                      + snapshot[line - 1].windowName + "): not found.");
+
+    if (!plan.missingLines.empty() && opts.failFast) return plan.missingLines.size();
+
+    beginPhase("restore");
+    return plan.missingLines.size() + executePlan(i3conn, plan, opts);
+}
+
+size_t markWindows(const i3ipc::connection &i3conn, const Snapshot &snapshot, const CommandLineOptions &opts) {
+    RestorePlan plan;
+
+    for (size_t i = 0; i < snapshot.size(); i++) {
+        const WindowRecord &record = snapshot[i];
+        if (record.mark.empty()) continue;
+
+        appendStep(plan, PlanStep{MARK_WINDOW, "[con_id=" + to_string(record.windowId) + "] mark --add " + record.mark,
+                                  record.workspaceName, i + 1}, PRIORITY_HIDDEN);
+    }
+
+    beginPhase("mark");
+    return executePlan(i3conn, plan, opts);
+}
+
+size_t unmarkWindows(const i3ipc::connection &i3conn, const CommandLineOptions &opts) {
+    beginPhase("fetch");
+    armRequest();
+    auto tree = i3conn.get_tree();
+    ConIndex live(*tree);
+
+    RestorePlan plan;
+    for (auto &con : live.all())
+        if (isWindow(*con.container))
+            appendStep(plan, PlanStep{MARK_WINDOW, "unmark " + windowMark(con.xwindowId), "", 0}, PRIORITY_HIDDEN);
+
+    beginPhase("unmark");
+    return executePlan(i3conn, plan, opts);
+}
+
+void printPlan(ostream &out, const RestorePlan &plan) {
+    out << "Records: " << plan.records << ", already in place: " << plan.inPlace << ", missing: "
+        << plan.missingLines.size() << "\n";
+
+    for (auto line : plan.missingLines) out << "  line " << line << ": window not found in live tree\n";
+    for (auto &output : plan.inactiveOutputs) out << "  output " << output << " is not active, workspaces stay put\n";
+
+    for (size_t i = 0; i < plan.batches.size(); i++) {
+        const PlanBatch &batch = plan.batches[i];
+        out << "Batch " << i + 1 << " (" << priorityName(batch.priority) << ", " << batch.steps.size()
+            << " commands, " << batch.bytes << " bytes):\n";
+
+        for (auto &step : batch.steps)
+            out << "  line " << step.line << ": " << step.command << "\n";
+    }
+
+    out << "Commands: " << plan.commandCount() << ", IPC batches: " << plan.batches.size()
+        << ", expected relayouts: " << plan.expectedRelayouts() << endl;
+}
+
+/**
+ * Quote a string for a POSIX shell.
+ */
+static string shellQuote(const string &value) {
+    string quoted = "'";
+    for (char c : value) {
+        if (c == '\'') quoted += "'\\''";
+        else quoted += c;
+    }
+    return quoted + "'";
+}
+
+void writePlanScript(ostream &out, const RestorePlan &plan) {
+    string payload;
+    for (auto &batch : plan.batches) {
+        if (!payload.empty()) payload += "; ";
+        payload += joinBatch(batch);
+    }
+
+    out << "#!/bin/sh\n"
+        << "# i3-snapshot restore plan: " << plan.commandCount() << " commands\n";
+
+    if (payload.empty()) {
+        out << "exit 0" << endl;
+        return;
+    }
+
+    out << "exec i3-msg " << shellQuote(payload) << endl;
+}
@@ -0,0 +1,206 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_PLAN_H
+#define I3_SNAPSHOT_PLAN_H
+
+#include <functional>
+#include <iosfwd>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "con_index.h"
+#include "prefetch.h"
+#include "snapshot.h"
+#include "workspace_index.h"
+
+/**
+ * Upper bounds on what is chained into a single i3 COMMAND message.  i3 re-renders
+ * the tree once per message, so fewer larger batches mean fewer relayouts.
+ */
+const size_t MAX_BATCH_COMMANDS = 64;
+const size_t MAX_BATCH_BYTES = 16 * 1024;
+
+enum PlanStepKind {
+    // MOVE_WINDOWS moves all windows matching class, instance or workspace criteria.
+    MOVE_WORKSPACE, MOVE_WINDOW, MOVE_WINDOWS, MOVE_SCRATCHPAD, MARK_WINDOW,
+    // Structural edits of a full-layout restore
+    EDIT_MARK, EDIT_MOVE, EDIT_SPLIT, EDIT_LAYOUT, EDIT_SWAP, EDIT_RESIZE, EDIT_FOCUS
+};
+
+typedef std::vector<std::shared_ptr<i3ipc::output_t>> OutputList;
+
+/**
+ * Restore order of a workspace, by what the user is currently looking at.
+ */
+enum PlanPriority {
+    PRIORITY_FOCUSED, PRIORITY_VISIBLE, PRIORITY_HIDDEN
+};
+
+/**
+ * A single i3 command of a restore plan.
+ */
+struct PlanStep {
+    PlanStepKind kind;
+    std::string command;
+    std::string workspaceName;
+    size_t line;
+    // con_id of the live workspace the step targets, 0 if the restore creates it.
+    size_t workspaceId{};
+};
+
+/**
+ * Commands chained into one IPC message.
+ */
+struct PlanBatch {
+    std::vector<PlanStep> steps;
+    size_t bytes{};
+    PlanPriority priority{PRIORITY_HIDDEN};
+};
+
+/**
+ * The commands needed to bring the live tree to a snapshot, after dropping no-ops.
+ */
+struct RestorePlan {
+    std::vector<PlanBatch> batches;
+    size_t records{};
+    size_t inPlace{};
+    std::vector<size_t> missingLines;
+    std::set<std::string> inactiveOutputs;
+
+    size_t commandCount() const;
+
+    /**
+     * i3 renders once after each COMMAND message that changed the tree.
+     */
+    size_t expectedRelayouts() const { return batches.size(); }
+};
+
+/**
+ * @return the restore priority of a live workspace; nullptr is hidden.
+ */
+PlanPriority workspacePriority(const LiveWorkspace *workspace);
+
+/**
+ * Append a step to the last batch of a plan, starting a new batch when the priority
+ * changes or a batch limit would be exceeded.
+ */
+void appendStep(RestorePlan &plan, PlanStep &&step, PlanPriority priority);
+
+/**
+ * Diff a snapshot against the live tree and compute the commands to restore it.
+ * Each snapshot workspace is resolved to a live one once, up front; commands then address
+ * workspaces by con_id and never by name.  Work on the focused and visible workspaces is
+ * scheduled first, in batches of its own.
+ * @param saved snapshot to restore
+ * @param live index of the current tree
+ * @param workspaces index of the live workspaces
+ * @param outputs live outputs; workspaces are not moved to inactive ones.
+ * @param opts selects how windows are addressed.
+ * @return the batched plan.
+ */
+RestorePlan buildPlan(const Snapshot &saved, const ConIndex &live, const WorkspaceIndex &workspaces,
+                      const OutputList &outputs, const CommandLineOptions &opts);
+
+/**
+ * Fetch the live tree, workspaces and outputs concurrently and plan the restore of a snapshot.
+ */
+RestorePlan planRestore(const i3ipc::connection &i3conn, const Snapshot &snapshot, const CommandLineOptions &opts);
+
+/**
+ * Plan the restore of a snapshot against live state that was already fetched.
+ */
+RestorePlan planRestore(const LiveState &state, const Snapshot &snapshot, const CommandLineOptions &opts);
+
+/**
+ * Run hook after each batch executePlan() sends, e.g. to read the events it caused while
+ * they are fresh.  An empty hook removes it.
+ */
+void onBatchSent(std::function<void()> hook);
+
+/**
+ * Hand the messages about failed commands and missing windows of restores on this thread
+ * to sink instead of printing them to stderr, e.g. to return them from a library call.
+ * An empty sink restores printing.
+ */
+void onRestoreFailure(std::function<void(const std::string &)> sink);
+
+/**
+ * Send a plan to i3, one COMMAND message per batch.
+ * @param i3conn i3 connection
+ * @param plan plan from buildPlan()
+ * @param opts debug prints each batch, dryRun skips sending, failFast stops after the first
+ * batch with a failed command.
+ * @return number of failed commands, counting those i3 did not reach after a parse error.
+ */
+size_t executePlan(const i3ipc::connection &i3conn, const RestorePlan &plan, const CommandLineOptions &opts);
+
+/**
+ * Move every window of a snapshot back to its recorded workspace and output.
+ * @param i3conn i3 connection
+ * @param snapshot records to restore
+ * @param opts restore options; failFast stops at the first failure.
+ * @return number of failed commands plus windows missing from the live tree.
+ */
+size_t restoreSnapshot(const i3ipc::connection &i3conn, const Snapshot &snapshot, const CommandLineOptions &opts);
+
+/**
+ * Report windows of the plan that are missing, then send it.
+ * @param snapshot the snapshot the plan was built from
+ * @return number of missing windows plus failed commands.
+ */
+size_t executeRestore(const i3ipc::connection &i3conn, const Snapshot &snapshot, const RestorePlan &plan,
+                      const CommandLineOptions &opts);
+
+/**
+ * Give every window of a snapshot its snapshot mark, batched like a restore.
+ * @param snapshot records captured with marks
+ * @return number of failed commands.
+ */
+size_t markWindows(const i3ipc::connection &i3conn, const Snapshot &snapshot, const CommandLineOptions &opts);
+
+/**
+ * Remove the snapshot marks of all windows of the live tree, batched like a restore.
+ * @return number of failed commands.
+ */
+size_t unmarkWindows(const i3ipc::connection &i3conn, const CommandLineOptions &opts);
+
+/**
+ * Write a human readable description of the plan.
+ */
+void printPlan(std::ostream &out, const RestorePlan &plan);
+
+/**
+ * Write the plan as a shell script replaying every command with one i3-msg call.
+ */
+void writePlanScript(std::ostream &out, const RestorePlan &plan);
+
+#endif //I3_SNAPSHOT_PLAN_H
@@ -0,0 +1,105 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "prefetch.h"
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <thread>
+
+#include "deadline.h"
+#include "event_log.h"
+
+using namespace std;
+
+static string resolveSocketPath(const string &socketPath) {
+    return socketPath.empty() ? i3ipc::get_socketpath() : socketPath;
+}
+
+/**
+ * Run one request over a short-lived connection of its own, timed out at the deadline of
+ * the current request.  The thread is detached and shares only the promise with the
+ * caller, so a caller giving up at the deadline, or on an error of its own request, does
+ * not wait for it.
+ */
+template<typename Reply>
+static future<Reply> fetchAside(const string &path, uint64_t deadlineNs,
+                                function<Reply(const i3ipc::connection &)> request) {
+    auto reply = make_shared<promise<Reply>>();
+    future<Reply> result = reply->get_future();
+
+    thread([path, deadlineNs, request, reply]() {
+        try {
+            i3ipc::connection conn(path);
+            armSocket(conn.get_main_socket_fd(), deadlineNs);
+            reply->set_value(request(conn));
+        } catch (...) {
+            reply->set_exception(current_exception());
+        }
+    }).detach();
+
+    return result;
+}
+
+/**
+ * @return the reply, once it arrives or the deadline passes.
+ * @throws DeadlineExceeded if it did not arrive in time.
+ */
+template<typename Reply>
+static Reply awaitReply(future<Reply> &reply, uint64_t deadlineNs) {
+    if (deadlineNs != 0) {
+        uint64_t now = eventClockNs();
+        chrono::nanoseconds left(deadlineNs > now ? deadlineNs - now : 0);
+        if (reply.wait_for(left) != future_status::ready)
+            throw DeadlineExceeded("no reply from i3 in time");
+    }
+
+    return reply.get();
+}
+
+LiveState fetchLiveState(const i3ipc::connection &i3conn, const string &socketPath) {
+    string path = resolveSocketPath(socketPath);
+
+    armRequest();
+    uint64_t deadline = requestDeadline();
+
+    auto workspaces = fetchAside<vector<shared_ptr<i3ipc::workspace_t>>>(
+            path, deadline, [](const i3ipc::connection &conn) { return conn.get_workspaces(); });
+    auto outputs = fetchAside<vector<shared_ptr<i3ipc::output_t>>>(
+            path, deadline, [](const i3ipc::connection &conn) { return conn.get_outputs(); });
+
+    LiveState state;
+    state.tree = i3conn.get_tree();
+    state.workspaces = awaitReply(workspaces, deadline);
+    state.outputs = awaitReply(outputs, deadline);
+
+    return state;
+}
@@ -0,0 +1,59 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_PREFETCH_H
+#define I3_SNAPSHOT_PREFETCH_H
+
+#include <i3ipc++/ipc.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Replies to GET_TREE, GET_WORKSPACES and GET_OUTPUTS taken together.
+ */
+struct LiveState {
+    std::shared_ptr<i3ipc::container_t> tree;
+    std::vector<std::shared_ptr<i3ipc::workspace_t>> workspaces;
+    std::vector<std::shared_ptr<i3ipc::output_t>> outputs;
+};
+
+/**
+ * Fetch tree, workspaces and outputs concurrently.  The tree is read on the given
+ * connection while workspaces and outputs are read over two short-lived parallel
+ * connections, so the wait is that of the slowest reply rather than the sum.
+ * @param i3conn connection used for GET_TREE
+ * @param socketPath i3 socket for the parallel connections, empty for the session default.
+ * All three requests share one armRequest() deadline.
+ * @throws the first error of any of the requests, DeadlineExceeded if one is late.
+ */
+LiveState fetchLiveState(const i3ipc::connection &i3conn, const std::string &socketPath = "");
+
+#endif //I3_SNAPSHOT_PREFETCH_H
@@ -0,0 +1,226 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "resident.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <thread>
+
+#include "con_index.h"
+#include "deadline.h"
+#include "event_log.h"
+#include "plan.h"
+
+using namespace std;
+
+/**
+ * First and longest delay between reconnection attempts.
+ */
+static const int RECONNECT_MIN_MS = 50;
+static const int RECONNECT_MAX_MS = 2000;
+
+/**
+ * Connect to i3, retrying with exponential backoff while it starts up.
+ * @param waitMs how long to keep retrying, 0 for a single attempt
+ * @return the connection, or nullptr if i3 did not come back in time.
+ */
+static unique_ptr<i3ipc::connection> reconnect(const CommandLineOptions &opts, int waitMs) {
+    uint64_t endNs = eventClockNs() + static_cast<uint64_t>(waitMs) * 1000000u;
+    int delayMs = RECONNECT_MIN_MS;
+
+    while (true) {
+        try {
+            // The socket path is looked up again, a new i3 may have a new one.
+            unique_ptr<i3ipc::connection> i3conn(
+                    new i3ipc::connection(opts.socketPath.empty() ? i3ipc::get_socketpath() : opts.socketPath));
+            watchSocket(i3conn->get_main_socket_fd());
+            return i3conn;
+        } catch (const exception &e) {
+            if (eventClockNs() >= endNs) {
+                logEvent(EV_ERROR, 0, 0, 0, e.what(), strlen(e.what()));
+                return nullptr;
+            }
+        }
+
+        this_thread::sleep_for(chrono::milliseconds(delayMs));
+        delayMs = min(delayMs * 2, RECONNECT_MAX_MS);
+    }
+}
+
+/**
+ * Point the records of a capture taken before a restart at the con_ids of the new tree.
+ * Records of windows that did not come back are dropped.  Workspace con_ids are not
+ * carried over, so workspaces are matched by name and number only.
+ * @param saved records with snapshot marks, see captureSnapshot()
+ */
+static Snapshot resolveByXWindow(const Snapshot &saved, const ConIndex &live) {
+    Snapshot resolved;
+    resolved.reserve(saved.size());
+
+    for (auto &record : saved) {
+        const ConRecord *current = live.findByXWindow(markedXWindow(record.mark));
+        if (current == nullptr) continue;
+
+        resolved.push_back(record);
+        resolved.back().windowId = current->container->id;
+        // con_ids are addresses in the old i3 and may name an unrelated container now.
+        resolved.back().workspaceId = 0;
+        // The windows carry no such marks; they are addressed by their new con_id instead.
+        resolved.back().mark.clear();
+    }
+
+    return resolved;
+}
+
+/**
+ * Restore a capture taken before i3 restarted.
+ * @return the number of failed commands.
+ */
+static size_t restoreAfterRestart(const i3ipc::connection &i3conn, const Snapshot &saved,
+                                  const CommandLineOptions &opts) {
+    beginPhase("fetch");
+    armRequest();
+    auto tree = i3conn.get_tree();
+    Snapshot resolved = resolveByXWindow(saved, ConIndex(*tree));
+
+    if (opts.debug)
+        cerr << "i3 restarted, restoring " << resolved.size() << " of " << saved.size() << " windows" << endl;
+
+    // Only the window con_ids just resolved above are current.
+    CommandLineOptions restoreOpts = opts;
+    restoreOpts.windowIdentifier = I3_ID;
+    return restoreSnapshot(i3conn, resolved, restoreOpts);
+}
+
+/**
+ * @return true if a window event can change where windows are.  Title, focus, urgency
+ * and mark changes cannot, and a window retitling itself many times a second would
+ * otherwise hold off captures.
+ */
+static bool changesPlacement(i3ipc::WindowEventType type) {
+    return type == i3ipc::WindowEventType::NEW || type == i3ipc::WindowEventType::CLOSE ||
+           type == i3ipc::WindowEventType::MOVE || type == i3ipc::WindowEventType::FLOATING;
+}
+
+static bool changesPlacement(i3ipc::WorkspaceEventType type) {
+    return type != i3ipc::WorkspaceEventType::FOCUS && type != i3ipc::WorkspaceEventType::URGENT;
+}
+
+/**
+ * Follow one i3 instance until its event socket closes.
+ * @param saved latest capture, kept up to date
+ */
+static void followSession(i3ipc::connection &i3conn, Snapshot &saved) {
+    // Time of the first and the last change since the last capture, 0 if there was none.
+    uint64_t firstChangeNs = 0;
+    uint64_t lastChangeNs = 0;
+    auto changed = [&]() {
+        lastChangeNs = eventClockNs();
+        if (firstChangeNs == 0) firstChangeNs = lastChangeNs;
+    };
+
+    i3conn.subscribe(i3ipc::ET_WINDOW | i3ipc::ET_WORKSPACE);
+    i3conn.prepare_to_event_handling();
+    i3conn.signal_window_event.connect([&](const i3ipc::window_event_t &ev) {
+        if (changesPlacement(ev.type)) changed();
+    });
+    i3conn.signal_workspace_event.connect([&](const i3ipc::workspace_event_t &ev) {
+        if (changesPlacement(ev.type)) changed();
+    });
+
+    saved = captureSnapshot(i3conn, true);
+
+    pollfd events{i3conn.get_event_socket_fd(), POLLIN, 0};
+    while (true) {
+        int timeoutMs = -1;
+        if (firstChangeNs != 0) {
+            uint64_t captureNs = min(lastChangeNs + static_cast<uint64_t>(RESIDENT_CAPTURE_QUIET_MS) * 1000000u,
+                                     firstChangeNs + static_cast<uint64_t>(RESIDENT_CAPTURE_MAX_DELAY_MS) * 1000000u);
+            uint64_t now = eventClockNs();
+            timeoutMs = captureNs > now ? static_cast<int>((captureNs - now + 999999) / 1000000) : 0;
+        }
+
+        // Due captures go first, however many events are waiting.
+        int ready = timeoutMs == 0 ? 0 : poll(&events, 1, timeoutMs);
+
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+
+        if (ready == 0) {
+            // A capture failing here means i3 is going away; keep the previous one.
+            saved = captureSnapshot(i3conn, true);
+            firstChangeNs = lastChangeNs = 0;
+        } else if (events.revents & POLLIN) {
+            // A closed socket reads as end of file, which i3ipc++ reports as an error.
+            i3conn.handle_event();
+        } else {
+            return;
+        }
+    }
+}
+
+int runResident(const CommandLineOptions &opts) {
+    Snapshot saved;
+    bool restarted = false;
+
+    while (true) {
+        beginPhase("connect");
+        unique_ptr<i3ipc::connection> i3conn = reconnect(opts, restarted ? RESIDENT_RECONNECT_MS : 0);
+        if (!i3conn) {
+            if (!restarted) return 1;
+
+            // i3 exited rather than restarted.
+            cerr << "i3 did not come back within " << RESIDENT_RECONNECT_MS << " ms." << endl;
+            return 0;
+        }
+
+        try {
+            if (restarted && !saved.empty()) {
+                // Taken out first so that a restore failing with the connection is not repeated.
+                Snapshot pending;
+                pending.swap(saved);
+                restoreAfterRestart(*i3conn, pending, opts);
+            }
+            followSession(*i3conn, saved);
+        } catch (const exception &e) {
+            logEvent(EV_ERROR, 0, 0, 0, e.what(), strlen(e.what()));
+            if (opts.debug) cerr << "Lost i3 connection: " << e.what() << endl;
+        }
+
+        restarted = true;
+    }
+}
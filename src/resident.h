@@ -0,0 +1,64 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_RESIDENT_H
+#define I3_SNAPSHOT_RESIDENT_H
+
+#include "snapshot.h"
+
+/**
+ * Time without placement changes after which the resident snapshot is refreshed.
+ */
+const int RESIDENT_CAPTURE_QUIET_MS = 200;
+
+/**
+ * Longest time a placement change waits for a capture while the tree keeps changing.
+ */
+const int RESIDENT_CAPTURE_MAX_DELAY_MS = 2000;
+
+/**
+ * Longest time to wait for i3 to come back after its IPC connection closed.
+ */
+const int RESIDENT_RECONNECT_MS = 60000;
+
+/**
+ * Stay connected to i3 and put windows back after it restarts in place.  The placement of
+ * every window is captured whenever windows or workspaces were added, removed or moved and
+ * then stayed put for RESIDENT_CAPTURE_QUIET_MS, or at the latest RESIDENT_CAPTURE_MAX_DELAY_MS
+ * after the first change.
+ * When the event socket closes, i3 is reconnected to with exponential backoff and the last
+ * capture is restored in one pass, each window found again by its X window id since con_ids
+ * do not survive the restart.
+ * @param opts options, used for every restore
+ * @return exit code once i3 did not come back within RESIDENT_RECONNECT_MS.
+ */
+int runResident(const CommandLineOptions &opts);
+
+#endif //I3_SNAPSHOT_RESIDENT_H
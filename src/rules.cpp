@@ -0,0 +1,176 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rules.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
+
+using namespace std;
+
+/**
+ * Properties of one saved window.
+ */
+struct WindowKey {
+    string windowClass;
+    string instance;
+    string role;
+    const string *workspaceName;
+};
+
+/**
+ * Windows sharing properties at one level of specificity, by workspace.
+ */
+typedef map<tuple<string, string, string>, map<string, size_t>> RuleGroups;
+
+string windowProperty(const i3ipc::container_t &c, const char *name) {
+    auto found = c.window_properties.find(name);
+    return found == c.window_properties.end() ? "" : found->second;
+}
+
+string criterion(const string &value) {
+    // i3 unescapes \\ and \" in quoted strings before PCRE sees the regex, so the
+    // backslash escaping a metacharacter has to be doubled.
+    string escaped = "\"^";
+    for (char c : value) {
+        if (c == '\\') {
+            escaped += "\\\\\\\\";
+        } else if (c == '"') {
+            escaped += "\\\"";
+        } else {
+            if (string("^$.|?*+()[]{}").find(c) != string::npos) escaped += "\\\\";
+            escaped += c;
+        }
+    }
+    return escaped + "$\"";
+}
+
+static tuple<string, string, string> keyAt(const WindowKey &key, int level) {
+    return make_tuple(key.windowClass, level >= 2 ? key.instance : "", level >= 3 ? key.role : "");
+}
+
+vector<WindowRule> buildRules(const Snapshot &snapshot, const ConIndex &live, WindowIdentifier identifier,
+                              size_t &missing) {
+    vector<WindowKey> keys;
+    keys.reserve(snapshot.size());
+    missing = 0;
+
+    unordered_map<string, const ConRecord *> liveByTitle;
+    if (identifier == WINDOW_TITLE)
+        for (auto &con : live.all())
+            if (isWindow(*con.container)) liveByTitle.emplace(con.container->name, &con);
+
+    for (auto &record : snapshot) {
+        // Found like a restore finds it, see buildPlan().
+        const ConRecord *window = nullptr;
+        if (!record.mark.empty()) {
+            window = live.findByXWindow(markedXWindow(record.mark));
+        } else if (identifier == I3_ID) {
+            window = live.find(record.windowId);
+        } else {
+            auto found = liveByTitle.find(record.windowName);
+            if (found != liveByTitle.end()) window = found->second;
+        }
+
+        if (window == nullptr || !isWindow(*window->container)) {
+            missing++;
+            continue;
+        }
+
+        WindowKey key{windowProperty(*window->container, "class"), windowProperty(*window->container, "instance"),
+                      windowProperty(*window->container, "window_role"), &record.workspaceName};
+        if (key.windowClass.empty()) {
+            missing++;
+            continue;
+        }
+        keys.push_back(move(key));
+    }
+
+    // Level 1 matches class, 2 class and instance, 3 class, instance and role.
+    RuleGroups groups[4];
+    for (auto &key : keys)
+        for (int level = 1; level <= 3; level++) groups[level][keyAt(key, level)][*key.workspaceName]++;
+
+    vector<WindowRule> rules;
+    for (int level = 1; level <= 3; level++) {
+        for (auto &group : groups[level]) {
+            const tuple<string, string, string> &properties = group.first;
+            const map<string, size_t> &workspaces = group.second;
+
+            // Covered by a less specific rule already.
+            if (level > 1 && groups[level - 1][keyAt(WindowKey{get<0>(properties), get<1>(properties),
+                                                              get<2>(properties), nullptr}, level - 1)].size() == 1)
+                continue;
+            if (level > 2 && groups[1][keyAt(WindowKey{get<0>(properties), "", "", nullptr}, 1)].size() == 1)
+                continue;
+            if (workspaces.size() > 1 && level < 3) continue;
+
+            auto best = max_element(workspaces.begin(), workspaces.end(),
+                                    [](const pair<const string, size_t> &a, const pair<const string, size_t> &b) {
+                                        return a.second < b.second;
+                                    });
+
+            WindowRule rule{get<0>(properties), get<1>(properties), get<2>(properties), best->first, best->second, 0};
+            for (auto &workspace : workspaces)
+                if (&workspace != &*best) rule.conflicts += workspace.second;
+            rules.push_back(move(rule));
+        }
+    }
+
+    // i3 uses the first assignment that matches, so a more specific rule has to come before
+    // the broader one that would otherwise catch its windows too.
+    stable_sort(rules.begin(), rules.end(), [](const WindowRule &a, const WindowRule &b) {
+        return a.specificity() > b.specificity();
+    });
+
+    return rules;
+}
+
+void writeRules(ostream &out, const vector<WindowRule> &rules) {
+    out << "# i3 assign rules generated by i3-snapshot --emit-rules\n";
+
+    for (auto &rule : rules) {
+        out << "assign [class=" << criterion(rule.windowClass);
+        if (!rule.instance.empty()) out << " instance=" << criterion(rule.instance);
+        if (!rule.role.empty()) out << " window_role=" << criterion(rule.role);
+        out << "] workspace " << std::quoted(rule.workspaceName);
+
+        out << "  # " << rule.windows << (rule.windows == 1 ? " window" : " windows");
+        if (rule.conflicts > 0) out << ", " << rule.conflicts << " elsewhere";
+        out << "\n";
+    }
+
+    out.flush();
+}
@@ -0,0 +1,91 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_RULES_H
+#define I3_SNAPSHOT_RULES_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "con_index.h"
+#include "snapshot.h"
+
+/**
+ * An i3 assign rule placing windows with matching properties on a workspace.  Empty
+ * instance or role match any value.
+ */
+struct WindowRule {
+    std::string windowClass;
+    std::string instance;
+    std::string role;
+    std::string workspaceName;
+    // Windows of the snapshot the rule places.
+    size_t windows{};
+    // Windows with the same properties that were saved on another workspace.
+    size_t conflicts{};
+
+    /**
+     * @return number of properties matched, higher is more specific.
+     */
+    int specificity() const { return 1 + !instance.empty() + !role.empty(); }
+};
+
+/**
+ * @return a window property of a container, empty if it has none.
+ */
+std::string windowProperty(const i3ipc::container_t &c, const char *name);
+
+/**
+ * @return value as an anchored i3 criteria regex in double quotes, matching exactly value
+ * once i3 has unescaped the quoted string.
+ */
+std::string criterion(const std::string &value);
+
+/**
+ * Turn a snapshot into assign rules.  Class, instance and role of each window are read
+ * from the live tree.  Windows are covered by the least specific rule that places all of
+ * them on the same workspace: class alone, then class and instance, then all three; at the
+ * last level conflicts go to the workspace most of the windows were on.
+ * @param snapshot saved placement
+ * @param live index of the live tree the snapshot was taken from
+ * @param identifier how windows without a snapshot mark are found, as for a restore
+ * @param missing receives the number of windows not found in the live tree
+ * @return the rules, most specific first.
+ */
+std::vector<WindowRule> buildRules(const Snapshot &snapshot, const ConIndex &live, WindowIdentifier identifier,
+                                   size_t &missing);
+
+/**
+ * Write rules as i3 config lines, to be loaded with include.
+ */
+void writeRules(std::ostream &out, const std::vector<WindowRule> &rules);
+
+#endif //I3_SNAPSHOT_RULES_H
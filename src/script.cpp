@@ -0,0 +1,228 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "script.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "atomic_file.h"
+#include "deadline.h"
+#include "event_log.h"
+#include "layout.h"
+#include "plan.h"
+#include "prefetch.h"
+
+using namespace std;
+
+/**
+ * Live state shared by the operations of a script, fetched in parts on first use.
+ */
+class TreeCache {
+public:
+    explicit TreeCache(const i3ipc::connection &i3conn) : i3conn(i3conn) {}
+
+    const i3ipc::container_t &tree() {
+        if (!state.tree) {
+            beginPhase("fetch");
+            armRequest();
+            state.tree = i3conn.get_tree();
+            fetches++;
+        }
+        return *state.tree;
+    }
+
+    /**
+     * @return tree, workspaces and outputs.
+     */
+    const LiveState &live() {
+        tree();
+        if (!haveLists) {
+            // On the same connection: a script keeps to one.
+            armRequest();
+            state.workspaces = i3conn.get_workspaces();
+            armRequest();
+            state.outputs = i3conn.get_outputs();
+            haveLists = true;
+        }
+        return state;
+    }
+
+    /**
+     * Forget everything after the tree was changed.
+     */
+    void invalidate() {
+        state = LiveState();
+        haveLists = false;
+    }
+
+    size_t fetches{};
+
+private:
+    const i3ipc::connection &i3conn;
+    LiveState state;
+    bool haveLists{};
+};
+
+vector<string> readScript(istream &in) {
+    vector<string> operations;
+    string line;
+
+    while (getline(in, line)) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == string::npos || line[start] == '#') continue;
+        operations.push_back(line.substr(start));
+    }
+
+    return operations;
+}
+
+static string readFile(const string &path) {
+    if (path == "-") throw invalid_argument("input cannot be stdin in a script");
+
+    ifstream in(path);
+    if (!in) throw runtime_error("Unable to read " + path);
+
+    ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+static void writeFile(const string &path, const string &contents, const CommandLineOptions &opts) {
+    if (path == "-") {
+        cout << contents;
+        cout.flush();
+    } else {
+        writeFileAtomically(path, contents, opts.fsyncOut);
+    }
+}
+
+static Snapshot snapshotOf(const i3ipc::container_t &tree) {
+    Snapshot snapshot;
+    TreeState treeState;
+    findWindows(tree, treeState, snapshot);
+    return snapshot;
+}
+
+/**
+ * Run one operation.
+ * @return true if it succeeded.
+ */
+static bool runOperation(const i3ipc::connection &i3conn, TreeCache &cache, const string &operation,
+                         const CommandLineOptions &opts) {
+    size_t space = operation.find(' ');
+    string verb = operation.substr(0, space);
+    string path = space == string::npos ? "" : operation.substr(operation.find_first_not_of(' ', space));
+    if (path.empty()) throw invalid_argument("missing file in '" + operation + "'");
+
+    if (verb == "capture") {
+        ostringstream out;
+        writeSnapshot(out, snapshotOf(cache.tree()), opts.encodeStrings);
+        writeFile(path, out.str(), opts);
+        return true;
+    }
+
+    if (verb == "capture-layout") {
+        ostringstream out;
+        writeLayout(out, captureLayout(cache.tree()));
+        writeFile(path, out.str(), opts);
+        return true;
+    }
+
+    istringstream in(readFile(path));
+
+    if (verb == "restore" && readLayoutHeader(in)) {
+        LayoutNode saved = readLayout(in);
+        size_t failures = restoreLayout(i3conn, saved, opts);
+        if (!opts.dryRun) cache.invalidate();
+        return failures == 0;
+    }
+
+    Snapshot saved = readSnapshot(in);
+
+    if (verb == "restore") {
+        RestorePlan plan = planRestore(cache.live(), saved, opts);
+        size_t failures = executeRestore(i3conn, saved, plan, opts);
+        if (!opts.dryRun && plan.commandCount() > 0) cache.invalidate();
+        return failures == 0;
+    }
+
+    if (verb == "plan") {
+        printPlan(cout, planRestore(cache.live(), saved, opts));
+        return true;
+    }
+
+    if (verb == "verify") {
+        RestorePlan plan = planRestore(cache.live(), saved, opts);
+        size_t misplaced = plan.records - plan.inPlace - plan.missingLines.size();
+        if (misplaced == 0 && plan.missingLines.empty()) return true;
+
+        cerr << path << ": " << misplaced << " windows out of place, " << plan.missingLines.size() << " missing."
+             << endl;
+        return false;
+    }
+
+    if (verb == "diff") {
+        writeSnapshot(cout, diffSnapshots(saved, snapshotOf(cache.tree())), opts.encodeStrings);
+        return true;
+    }
+
+    throw invalid_argument("unknown operation '" + verb + "'");
+}
+
+size_t runScript(const i3ipc::connection &i3conn, const vector<string> &operations, const CommandLineOptions &opts) {
+    TreeCache cache(i3conn);
+    size_t failures = 0;
+
+    for (size_t i = 0; i < operations.size(); i++) {
+        bool succeeded;
+        try {
+            succeeded = runOperation(i3conn, cache, operations[i], opts);
+        } catch (const DeadlineExceeded &) {
+            throw;
+        } catch (const exception &e) {
+            logEvent(EV_ERROR, 0, static_cast<uint32_t>(i), 0, e.what(), strlen(e.what()));
+            cerr << "Operation " << i + 1 << " (" << operations[i] << "): " << e.what() << endl;
+            succeeded = false;
+        }
+
+        if (!succeeded) {
+            failures++;
+            if (opts.failFast) break;
+        }
+    }
+
+    if (opts.debug) cerr << "# " << operations.size() << " operations, " << cache.fetches << " tree fetches" << endl;
+
+    return failures;
+}
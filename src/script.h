@@ -0,0 +1,65 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_SCRIPT_H
+#define I3_SNAPSHOT_SCRIPT_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "snapshot.h"
+
+/**
+ * Read script operations, one per line, skipping blank lines and # comments.
+ */
+std::vector<std::string> readScript(std::istream &in);
+
+/**
+ * Run several operations over one i3 connection.  The tree, workspaces and outputs are
+ * fetched when an operation first needs them and reused until an operation changes the
+ * tree.  Operations, with "-" for stdout as FILE:
+ *
+ *     capture FILE          save a snapshot
+ *     capture-layout FILE   save a full-layout snapshot
+ *     restore FILE          restore a snapshot or full-layout snapshot
+ *     plan FILE             print the restore plan of a snapshot
+ *     diff FILE             print the saved records of windows placed differently now
+ *     verify FILE           fail unless every window of the snapshot is in place
+ *
+ * @param i3conn i3 connection
+ * @param operations the operations in order
+ * @param opts options applied to every operation
+ * @return number of failed operations; with failFast the script stops at the first.
+ */
+size_t runScript(const i3ipc::connection &i3conn, const std::vector<std::string> &operations,
+                 const CommandLineOptions &opts);
+
+#endif //I3_SNAPSHOT_SCRIPT_H
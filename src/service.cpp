@@ -0,0 +1,553 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "service.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "deadline.h"
+#include "event_log.h"
+#include "persistent_snapshot.h"
+#include "plan.h"
+
+using namespace std;
+
+/**
+ * Longest request line accepted; longer ones close the client.
+ */
+static const size_t MAX_REQUEST_BYTES = 4096;
+
+/**
+ * Time a worker gets past SERVICE_SESSION_TIMEOUT_MS to report its own timeout before it
+ * is killed.
+ */
+static const int WORKER_GRACE_MS = 1000;
+
+/**
+ * Stored snapshots and usage of one user.
+ */
+struct UserSessions {
+    SnapshotStore store;
+    map<string, size_t> slotBytes;
+    size_t bytes{};
+};
+
+struct ServiceClient {
+    int fd{-1};
+    uid_t uid{};
+    string i3Socket;
+    string in;
+    string out;
+    bool closing{};
+    bool hungUp{};
+
+    // Child process running the client's current i3 request, see startWorker().
+    pid_t worker{-1};
+    int workerFd{-1};
+    string workerVerb;
+    string workerSlot;
+    string workerOut;
+    uint64_t workerDeadlineNs{};
+};
+
+/**
+ * @return the i3 IPC socket of the user's most recently started session, or "".
+ */
+static string findUserSocket(uid_t uid) {
+    string directory = "/run/user/" + to_string(uid) + "/i3";
+    DIR *dir = opendir(directory.c_str());
+    if (dir == nullptr) return "";
+
+    string newest;
+    time_t newestTime = 0;
+    while (dirent *entry = readdir(dir)) {
+        if (strncmp(entry->d_name, "ipc-socket.", 11) != 0) continue;
+
+        string path = directory + "/" + entry->d_name;
+        struct stat info{};
+        if (stat(path.c_str(), &info) != 0 || !S_ISSOCK(info.st_mode) || info.st_uid != uid) continue;
+
+        if (newest.empty() || info.st_mtime > newestTime) {
+            newest = path;
+            newestTime = info.st_mtime;
+        }
+    }
+    closedir(dir);
+
+    return newest;
+}
+
+static bool validSlotName(const string &name) {
+    if (name.empty() || name.size() > 64) return false;
+
+    for (char c : name)
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '_' && c != '-') return false;
+    return true;
+}
+
+/**
+ * @return the i3 socket of the client's session, as named by the client or found for it.
+ */
+static string sessionSocket(const ServiceClient &client) {
+    string path = client.i3Socket.empty() ? findUserSocket(client.uid) : client.i3Socket;
+    if (path.empty()) throw runtime_error("no i3 session found for uid " + to_string(client.uid));
+
+    return path;
+}
+
+/**
+ * Open a connection to the client's session, bounded like any other run.  The path is
+ * chosen by the client and may be replaced at any time, so ownership is checked on the
+ * connected socket: the i3 at the other end must run as the client.
+ * @throws std::runtime_error if it does not.
+ */
+static unique_ptr<i3ipc::connection> connectSession(const ServiceClient &client) {
+    unique_ptr<i3ipc::connection> i3conn(new i3ipc::connection(sessionSocket(client)));
+
+    ucred peer{};
+    socklen_t length = sizeof(peer);
+    if (getsockopt(i3conn->get_main_socket_fd(), SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 ||
+        peer.uid != client.uid)
+        throw runtime_error("i3 socket not owned by caller");
+
+    watchSocket(i3conn->get_main_socket_fd());
+    return i3conn;
+}
+
+/**
+ * Write all of data to a blocking descriptor.
+ */
+static void writeAll(int fd, const string &data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        written += static_cast<size_t>(n);
+    }
+}
+
+/**
+ * Run a request on the client's i3 session in a child process, so that a slow or wedged
+ * session holds up only the client that asked.  The child writes its reply to a pipe
+ * read by the poll loop, see finishWorker().
+ * @param work produces the reply, called in the child only.
+ */
+static void startWorker(ServiceClient &client, const string &verb, const string &slot,
+                        const function<string()> &work) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) throw runtime_error(string("pipe: ") + strerror(errno));
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        int error = errno;
+        close(fds[0]);
+        close(fds[1]);
+        throw runtime_error(string("fork: ") + strerror(error));
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        string reply;
+        try {
+            boundSession(SERVICE_SESSION_TIMEOUT_MS);
+            reply = work();
+        } catch (const exception &e) {
+            reply = string("ERR ") + (requestTimedOut() ? "request timed out" : e.what()) + "\n";
+        }
+        writeAll(fds[1], reply);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    client.worker = pid;
+    client.workerFd = fds[0];
+    client.workerVerb = verb;
+    client.workerSlot = slot;
+    client.workerOut.clear();
+    client.workerDeadlineNs = eventClockNs() + static_cast<uint64_t>(SERVICE_SESSION_TIMEOUT_MS + WORKER_GRACE_MS) * 1000000u;
+}
+
+/**
+ * Reap the client's worker, killing it if it still runs.
+ */
+static void stopWorker(ServiceClient &client) {
+    if (client.worker < 0) return;
+
+    kill(client.worker, SIGKILL);
+    close(client.workerFd);
+    while (waitpid(client.worker, nullptr, 0) < 0 && errno == EINTR) {}
+
+    client.worker = -1;
+    client.workerFd = -1;
+    client.workerOut.clear();
+}
+
+/**
+ * Run one request line.  Requests on the i3 session are handed to a worker.
+ * @return the reply, including its trailing newline, or "" if a worker will give it.
+ */
+static string handleRequest(ServiceClient &client, UserSessions &user, const string &line,
+                            const CommandLineOptions &opts) {
+    istringstream fields(line);
+    string verb, name;
+    fields >> verb >> name;
+
+    if (verb == "LIST") {
+        string reply = "OK";
+        for (auto &slot : user.slotBytes) reply += " " + slot.first;
+        return reply + "\n";
+    }
+
+    if (verb == "SOCKET") {
+        // Checked on every connection, see connectSession().
+        if (name.empty() || name[0] != '/') return "ERR invalid socket path\n";
+        client.i3Socket = name;
+        return "OK\n";
+    }
+
+    if (verb != "CAPTURE" && verb != "RESTORE" && verb != "GET" && verb != "DROP") return "ERR unknown request\n";
+    if (!validSlotName(name)) return "ERR invalid slot name\n";
+
+    if (verb == "CAPTURE") {
+        // The capture comes back serialized; finishWorker() checks the quota and stores it.
+        startWorker(client, verb, name, [&client]() {
+            beginPhase("capture");
+            auto i3conn = connectSession(client);
+            ostringstream out;
+            out << "OK\n";
+            writeSnapshot(out, captureSnapshot(*i3conn), true);
+            return out.str();
+        });
+        return "";
+    }
+
+    const PersistentSnapshot *stored = user.store.load(name);
+    if (stored == nullptr) return "ERR no such slot\n";
+
+    if (verb == "RESTORE") {
+        startWorker(client, verb, name, [&client, stored, &opts]() {
+            auto i3conn = connectSession(client);
+
+            // Fetched over the checked connection only: a parallel fetch would open new
+            // connections to a path the client may have replaced meanwhile.
+            beginPhase("fetch");
+            LiveState state;
+            armRequest();
+            state.tree = i3conn->get_tree();
+            armRequest();
+            state.workspaces = i3conn->get_workspaces();
+            armRequest();
+            state.outputs = i3conn->get_outputs();
+
+            Snapshot snapshot = stored->toSnapshot();
+            RestorePlan plan = planRestore(state, snapshot, opts);
+            return "OK " + to_string(executeRestore(*i3conn, snapshot, plan, opts)) + "\n";
+        });
+        return "";
+    }
+
+    if (verb == "GET") {
+        ostringstream out;
+        writeSnapshot(out, stored->toSnapshot(), true);
+        return "OK " + to_string(out.str().size()) + "\n" + out.str();
+    }
+
+    // DROP
+    user.store.remove(name);
+    user.bytes -= user.slotBytes[name];
+    user.slotBytes.erase(name);
+    user.store.strings().collect();
+    return "OK\n";
+}
+
+/**
+ * Turn the output of a finished worker into the client's reply.
+ */
+static string finishWorker(const string &verb, const string &slot, const string &output, UserSessions &user,
+                           const CommandLineOptions &opts) {
+    if (verb != "CAPTURE" || output.compare(0, 3, "OK\n") != 0) {
+        if (output.empty()) return "ERR request failed\n";
+        return output;
+    }
+
+    size_t size = output.size() - 3;
+    size_t previous = user.slotBytes.count(slot) > 0 ? user.slotBytes[slot] : 0;
+    if (user.bytes - previous + size > opts.serviceQuotaBytes) return "ERR quota exceeded\n";
+
+    istringstream in(output.substr(3));
+    Snapshot live = readSnapshot(in);
+
+    user.store.save(slot, live);
+    user.bytes = user.bytes - previous + size;
+    user.slotBytes[slot] = size;
+    return "OK " + to_string(live.size()) + "\n";
+}
+
+/**
+ * Read what the client's worker wrote, and reply once it is done.
+ */
+static void readWorker(ServiceClient &client, UserSessions &user, const CommandLineOptions &opts) {
+    char buffer[4096];
+    ssize_t received = read(client.workerFd, buffer, sizeof(buffer));
+    if (received < 0 && (errno == EAGAIN || errno == EINTR)) return;
+
+    if (received > 0) {
+        client.workerOut.append(buffer, static_cast<size_t>(received));
+        // A capture larger than the whole quota cannot be stored anyway.
+        if (client.workerOut.size() <= opts.serviceQuotaBytes + MAX_REQUEST_BYTES) return;
+        stopWorker(client);
+        client.out += "ERR quota exceeded\n";
+        return;
+    }
+
+    string output = move(client.workerOut);
+    stopWorker(client);
+
+    try {
+        client.out += finishWorker(client.workerVerb, client.workerSlot, output, user, opts);
+    } catch (const exception &e) {
+        client.out += string("ERR ") + e.what() + "\n";
+    }
+
+    if (client.out.compare(0, 4, "ERR ") == 0)
+        logEvent(EV_ERROR, 0, client.uid, 0, client.out.data() + 4, client.out.size() - 5);
+}
+
+/**
+ * Run the next complete request line buffered for the client, if it is not waiting on one.
+ */
+static void serveClient(ServiceClient &client, UserSessions &user, const CommandLineOptions &opts) {
+    size_t end = client.in.find('\n');
+    if (end == string::npos) {
+        if (client.in.size() > MAX_REQUEST_BYTES) client.closing = true;
+        return;
+    }
+
+    string line = client.in.substr(0, end);
+    client.in.erase(0, end + 1);
+
+    try {
+        client.out += handleRequest(client, user, line, opts);
+    } catch (const exception &e) {
+        logEvent(EV_ERROR, 0, client.uid, 0, e.what(), strlen(e.what()));
+        client.out += string("ERR ") + e.what() + "\n";
+    }
+}
+
+static bool hasRequest(const ServiceClient &client) {
+    return client.in.find('\n') != string::npos;
+}
+
+static int listenOn(const string &path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) throw runtime_error("service socket path too long");
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) throw runtime_error(string("socket: ") + strerror(errno));
+
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    unlink(path.c_str());
+
+    // Any local user may connect; each is confined to their own session by SO_PEERCRED.
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || chmod(path.c_str(), 0666) != 0 ||
+        listen(fd, 64) != 0) {
+        int error = errno;
+        close(fd);
+        throw runtime_error("unable to listen on " + path + ": " + strerror(error));
+    }
+
+    return fd;
+}
+
+/**
+ * Accept pending connections, up to MAX_SERVICE_CONNECTIONS_PER_UID per user.
+ * @param pausedUntilNs set when out of descriptors: the connection then stays queued and
+ * the socket readable, so accepting pauses instead of spinning.
+ */
+static void acceptClients(int listenFd, map<int, ServiceClient> &clients, map<uid_t, size_t> &connections,
+                          uint64_t &pausedUntilNs) {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+                pausedUntilNs = eventClockNs() + static_cast<uint64_t>(SERVICE_ACCEPT_BACKOFF_MS) * 1000000u;
+            return;
+        }
+
+        ucred credentials{};
+        socklen_t length = sizeof(credentials);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+            close(fd);
+            continue;
+        }
+
+        if (connections[credentials.uid] >= MAX_SERVICE_CONNECTIONS_PER_UID) {
+            static const char refusal[] = "ERR too many connections\n";
+            send(fd, refusal, sizeof(refusal) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+            close(fd);
+            continue;
+        }
+
+        connections[credentials.uid]++;
+        ServiceClient &client = clients[fd];
+        client.fd = fd;
+        client.uid = credentials.uid;
+    }
+}
+
+int runService(const string &listenPath, const CommandLineOptions &opts) {
+    int listenFd = listenOn(listenPath);
+    map<uid_t, UserSessions> users;
+    map<int, ServiceClient> clients;
+    map<uid_t, size_t> connections;
+    uint64_t acceptPausedUntilNs = 0;
+
+    if (opts.debug) cerr << "# serving on " << listenPath << endl;
+
+    while (true) {
+        uint64_t now = eventClockNs();
+        int timeoutMs = -1;
+        auto wakeAt = [&now, &timeoutMs](uint64_t deadlineNs) {
+            int ms = deadlineNs > now ? static_cast<int>((deadlineNs - now + 999999) / 1000000) : 0;
+            if (timeoutMs < 0 || ms < timeoutMs) timeoutMs = ms;
+        };
+
+        bool accepting = now >= acceptPausedUntilNs;
+        if (!accepting) wakeAt(acceptPausedUntilNs);
+
+        // Each entry after the listening socket belongs to the client at the same index.
+        vector<pollfd> fds{pollfd{listenFd, static_cast<short>(accepting ? POLLIN : 0), 0}};
+        vector<ServiceClient *> owners{nullptr};
+
+        for (auto &entry : clients) {
+            ServiceClient &client = entry.second;
+
+            // Requests are read one at a time, so a client cannot queue up work.
+            short events = 0;
+            if (!client.out.empty()) events = POLLOUT;
+            else if (client.worker < 0 && !hasRequest(client)) events = POLLIN;
+            fds.push_back(pollfd{client.fd, events, 0});
+            owners.push_back(&client);
+
+            if (client.worker >= 0) {
+                fds.push_back(pollfd{client.workerFd, POLLIN, 0});
+                owners.push_back(&client);
+                wakeAt(client.workerDeadlineNs);
+            } else if (client.out.empty() && hasRequest(client)) {
+                timeoutMs = 0;
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), timeoutMs) < 0) {
+            if (errno == EINTR) continue;
+            cerr << "poll: " << strerror(errno) << endl;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            acceptClients(listenFd, clients, connections, acceptPausedUntilNs);
+        } else if (fds[0].revents & (POLLERR | POLLNVAL)) {
+            cerr << "service socket failed" << endl;
+            break;
+        }
+
+        for (size_t i = 1; i < fds.size(); i++) {
+            if (fds[i].revents == 0) continue;
+            ServiceClient &client = *owners[i];
+
+            if (fds[i].fd == client.workerFd) {
+                readWorker(client, users[client.uid], opts);
+            } else if (fds[i].revents & POLLOUT) {
+                ssize_t sent = send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+                if (sent > 0) client.out.erase(0, static_cast<size_t>(sent));
+                else if (errno != EAGAIN && errno != EINTR) client.closing = true;
+            } else if (fds[i].revents & POLLIN) {
+                char buffer[4096];
+                ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+                if (received > 0) client.in.append(buffer, static_cast<size_t>(received));
+                else if (received == 0 || (errno != EAGAIN && errno != EINTR)) client.closing = true;
+            } else {
+                client.closing = true;
+            }
+
+            if (fds[i].fd == client.fd && (fds[i].revents & (POLLERR | POLLHUP))) client.hungUp = true;
+        }
+
+        // At most one request per client per pass, so no client waits on another's backlog.
+        now = eventClockNs();
+        for (auto &entry : clients) {
+            ServiceClient &client = entry.second;
+
+            if (client.worker >= 0 && now >= client.workerDeadlineNs) {
+                stopWorker(client);
+                logEvent(EV_ERROR, 0, client.uid, 0, "request timed out", 17);
+                client.out += "ERR request timed out\n";
+            }
+
+            if (!client.closing && client.worker < 0 && client.out.empty()) serveClient(client, users[client.uid], opts);
+        }
+
+        for (auto it = clients.begin(); it != clients.end();) {
+            ServiceClient &client = it->second;
+            if (!client.closing || (!client.out.empty() && !client.hungUp)) {
+                ++it;
+                continue;
+            }
+
+            stopWorker(client);
+            close(client.fd);
+            if (--connections[client.uid] == 0) connections.erase(client.uid);
+            it = clients.erase(it);
+        }
+    }
+
+    for (auto &entry : clients) stopWorker(entry.second);
+    close(listenFd);
+    return 1;
+}
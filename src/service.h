@@ -0,0 +1,83 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_SERVICE_H
+#define I3_SNAPSHOT_SERVICE_H
+
+#include "snapshot.h"
+
+/**
+ * Default limit on the snapshot bytes one user may keep in the service.
+ */
+const size_t DEFAULT_SERVICE_QUOTA_BYTES = 4u << 20;
+
+/**
+ * Longest time one request may spend on its i3 session before its worker gives up.
+ */
+const int SERVICE_SESSION_TIMEOUT_MS = 10000;
+
+/**
+ * Connections one user may hold open; further ones are refused.
+ */
+const size_t MAX_SERVICE_CONNECTIONS_PER_UID = 16;
+
+/**
+ * Pause in accepting connections once the process runs out of descriptors.
+ */
+const int SERVICE_ACCEPT_BACKOFF_MS = 100;
+
+/**
+ * Serve capture and restore for every user of the host on one UNIX socket.
+ *
+ * Clients are identified by SO_PEERCRED and requests run against the caller's own i3
+ * session, found under /run/user/<uid>/i3 or given with SOCKET and checked to belong to
+ * the caller.  Requests are lines; each gets one reply line, "OK ..." or "ERR reason":
+ *
+ *     CAPTURE name     capture the session into a named slot
+ *     RESTORE name     restore a slot, replying with the number of failures
+ *     GET name         reply "OK <bytes>" followed by the slot in snapshot format
+ *     DROP name        delete a slot
+ *     LIST             reply with the names of the caller's slots
+ *     SOCKET path      use this i3 socket for the following requests
+ *
+ * All clients are multiplexed by a single poll loop that never waits on i3: CAPTURE and
+ * RESTORE run in a child process per request, killed after SERVICE_SESSION_TIMEOUT_MS.
+ * The loop takes at most one request per client per pass and reads the next one only
+ * after replying, so a client cannot hold up others by queueing requests.  Slots of a
+ * user share strings and unchanged records, and their serialized size counts against a
+ * per-user quota.
+ *
+ * @param listenPath path of the service socket, replaced if it exists
+ * @param opts restore options, and the request timeout bounding every i3 request
+ * @return exit status once the listening socket fails.
+ */
+int runService(const std::string &listenPath, const CommandLineOptions &opts);
+
+#endif //I3_SNAPSHOT_SERVICE_H
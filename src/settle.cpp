@@ -0,0 +1,152 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "settle.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <poll.h>
+#include <vector>
+
+#include "event_log.h"
+#include "plan.h"
+
+using namespace std;
+
+SettleMonitor::SettleMonitor(i3ipc::connection &i3conn) : i3conn(i3conn), startNs(eventClockNs()) {
+    i3conn.subscribe(i3ipc::ET_WINDOW);
+    i3conn.prepare_to_event_handling();
+    i3conn.signal_window_event.connect([this](const i3ipc::window_event_t &ev) { handleWindowEvent(ev); });
+    onBatchSent([this]() { drain(); });
+}
+
+SettleMonitor::~SettleMonitor() {
+    onBatchSent(nullptr);
+}
+
+void SettleMonitor::drain() {
+    pollfd events{i3conn.get_event_socket_fd(), POLLIN, 0};
+
+    try {
+        while (poll(&events, 1, 0) > 0 && (events.revents & POLLIN)) i3conn.handle_event();
+    } catch (const exception &e) {
+        // wait() reports a failing event socket.
+        logEvent(EV_ERROR, 0, 0, 0, e.what(), strlen(e.what()));
+    }
+}
+
+void SettleMonitor::handleWindowEvent(const i3ipc::window_event_t &ev) {
+    if (!ev.container) return;
+
+    auto found = moved.find(ev.container->id);
+    if (found == moved.end()) {
+        // Only windows the restore moved are followed.
+        if (ev.type != i3ipc::WindowEventType::MOVE) return;
+
+        auto windowClass = ev.container->window_properties.find("class");
+        found = moved.emplace(ev.container->id, WindowSettle{}).first;
+        found->second.windowClass =
+                windowClass != ev.container->window_properties.end() ? windowClass->second : "(unknown)";
+    }
+
+    lastMovedEventNs = found->second.lastEventNs = eventClockNs();
+    found->second.events++;
+}
+
+void SettleMonitor::restoreDone() {
+    drain();
+    restoreDoneNs = eventClockNs();
+}
+
+void SettleMonitor::wait(int quietMs) {
+    uint64_t waitStartNs = eventClockNs();
+    uint64_t endNs = waitStartNs + static_cast<uint64_t>(MAX_SETTLE_MS) * 1000000u;
+    pollfd events{i3conn.get_event_socket_fd(), POLLIN, 0};
+
+    try {
+        while (true) {
+            uint64_t now = eventClockNs();
+            uint64_t quietEndNs = max(lastMovedEventNs, waitStartNs) + static_cast<uint64_t>(quietMs) * 1000000u;
+            uint64_t until = min(quietEndNs, endNs);
+            if (now >= until) break;
+
+            int ready = poll(&events, 1, static_cast<int>((until - now + 999999) / 1000000));
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (ready == 0) continue;
+            if (!(events.revents & POLLIN)) break;
+
+            i3conn.handle_event();
+        }
+    } catch (const exception &e) {
+        logEvent(EV_ERROR, 0, 0, 0, e.what(), strlen(e.what()));
+        cerr << "Stopped waiting for windows to settle: " << e.what() << endl;
+    }
+}
+
+void SettleMonitor::report(ostream &out, size_t limit) const {
+    struct ClassSettle {
+        size_t windows{};
+        uint64_t slowestNs{};
+        uint64_t totalNs{};
+    };
+    map<string, ClassSettle> classes;
+
+    for (auto &window : moved) {
+        uint64_t settleNs = window.second.lastEventNs > restoreDoneNs ? window.second.lastEventNs - restoreDoneNs : 0;
+        ClassSettle &settle = classes[window.second.windowClass];
+        settle.windows++;
+        settle.slowestNs = max(settle.slowestNs, settleNs);
+        settle.totalNs += settleNs;
+    }
+
+    vector<pair<string, ClassSettle>> slowest(classes.begin(), classes.end());
+    sort(slowest.begin(), slowest.end(), [](const pair<string, ClassSettle> &a, const pair<string, ClassSettle> &b) {
+        return a.second.slowestNs > b.second.slowestNs;
+    });
+
+    out << "Restore took " << (restoreDoneNs - startNs) / 1000000 << " ms, " << moved.size()
+        << " windows moved.\n";
+    if (slowest.empty()) return;
+
+    out << "Settle time after restore by class (windows, slowest ms, mean ms):\n";
+    for (size_t i = 0; i < slowest.size() && i < limit; i++) {
+        const ClassSettle &settle = slowest[i].second;
+        out << "  " << left << setw(24) << slowest[i].first << right << setw(6) << settle.windows << setw(10)
+            << settle.slowestNs / 1000000 << setw(10) << settle.totalNs / settle.windows / 1000000 << "\n";
+    }
+    out.flush();
+}
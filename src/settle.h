@@ -0,0 +1,106 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_SETTLE_H
+#define I3_SNAPSHOT_SETTLE_H
+
+#include <i3ipc++/ipc.hpp>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Default quiet period after which moved windows are considered settled.
+ */
+const int DEFAULT_SETTLE_QUIET_MS = 1000;
+
+/**
+ * Longest time spent waiting for windows to settle.
+ */
+const int MAX_SETTLE_MS = 30000;
+
+/**
+ * Measures how long windows keep changing after a restore moved them, to tell the time
+ * the restore takes apart from the time applications take to catch up.
+ *
+ * i3 reports window events (move, title, floating, ...) but no resize or redraw, so the
+ * settle time of a window is that of its last window event after the restore.  Events
+ * are read after every batch of the restore, so they are timed to within one batch of
+ * when i3 sent them rather than when the queue was drained.
+ */
+class SettleMonitor {
+public:
+    /**
+     * Subscribe to window events and read them after each batch executePlan() sends.
+     * Create before the restore is sent so that the moves it causes are seen.
+     */
+    explicit SettleMonitor(i3ipc::connection &i3conn);
+
+    ~SettleMonitor();
+
+    /**
+     * Handle the window events that already arrived, without waiting for more.
+     */
+    void drain();
+
+    /**
+     * Mark the end of the restore, from which settle times are measured.
+     */
+    void restoreDone();
+
+    /**
+     * Handle window events until no moved window had one for quietMs, for at most
+     * MAX_SETTLE_MS.
+     */
+    void wait(int quietMs);
+
+    /**
+     * Write the restore time and the slowest window classes.
+     * @param limit number of classes listed
+     */
+    void report(std::ostream &out, size_t limit = 10) const;
+
+private:
+    struct WindowSettle {
+        std::string windowClass;
+        uint64_t lastEventNs{};
+        size_t events{};
+    };
+
+    void handleWindowEvent(const i3ipc::window_event_t &ev);
+
+    i3ipc::connection &i3conn;
+    std::unordered_map<uint64_t, WindowSettle> moved;
+    uint64_t startNs;
+    uint64_t restoreDoneNs{};
+    uint64_t lastMovedEventNs{};
+};
+
+#endif //I3_SNAPSHOT_SETTLE_H
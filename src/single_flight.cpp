@@ -0,0 +1,213 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "single_flight.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/file.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * How often and how long a waiting request checks for a restore that was announced but
+ * has not taken the lock yet.
+ */
+static const int CLAIM_POLL_MS = 20;
+static const int CLAIM_POLLS = 50;
+
+/**
+ * Contents of the state file.
+ */
+struct FlightState {
+    // Generation of the latest request that announced itself, and its key.
+    uint64_t generation{};
+    string key;
+    // Generation of the last restore that finished, and its result.
+    uint64_t doneGeneration{};
+    size_t doneResult{};
+};
+
+static int stateFd = -1;
+static int lockFd = -1;
+static uint64_t ownGeneration;
+
+static uint64_t fnv1a(const string &data, uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static string hex(uint64_t value) {
+    char digits[17];
+    snprintf(digits, sizeof(digits), "%016llx", static_cast<unsigned long long>(value));
+    return digits;
+}
+
+string flightKey(const string &input, const string &variant) {
+    return hex(fnv1a(input, fnv1a(variant)));
+}
+
+/**
+ * Read the state file, whose lock the caller holds.
+ */
+static FlightState readState() {
+    char buffer[256];
+    ssize_t length = pread(stateFd, buffer, sizeof(buffer) - 1, 0);
+    buffer[length > 0 ? length : 0] = '\0';
+
+    FlightState state;
+    unsigned long long generation = 0, doneGeneration = 0, doneResult = 0;
+    char key[64] = "";
+    if (sscanf(buffer, "%llu %63s %llu %llu", &generation, key, &doneGeneration, &doneResult) == 4) {
+        state.generation = generation;
+        state.key = key;
+        state.doneGeneration = doneGeneration;
+        state.doneResult = doneResult;
+    }
+    return state;
+}
+
+/**
+ * Replace the state file, whose exclusive lock the caller holds.
+ */
+static void writeState(const FlightState &state) {
+    char buffer[256];
+    int length = snprintf(buffer, sizeof(buffer), "%llu %s %llu %llu\n",
+                          static_cast<unsigned long long>(state.generation), state.key.c_str(),
+                          static_cast<unsigned long long>(state.doneGeneration),
+                          static_cast<unsigned long long>(state.doneResult));
+    if (pwrite(stateFd, buffer, static_cast<size_t>(length), 0) != length || ftruncate(stateFd, length) != 0)
+        throw runtime_error("Unable to update restore state: " + string(strerror(errno)));
+}
+
+/**
+ * flock() that resumes after signals.
+ */
+static void lockFile(int fd, int operation) {
+    while (flock(fd, operation) != 0)
+        if (errno != EINTR) throw runtime_error("Unable to lock restore state: " + string(strerror(errno)));
+}
+
+static FlightState lockedState(int operation) {
+    lockFile(stateFd, operation);
+    FlightState state = readState();
+    if (operation == LOCK_SH) lockFile(stateFd, LOCK_UN);
+    return state;
+}
+
+/**
+ * Open the files of a session.
+ * @return false if there is no runtime directory to coordinate through.
+ */
+static bool openFiles(const string &session) {
+    const char *runtimeDir = getenv("XDG_RUNTIME_DIR");
+    if (runtimeDir == nullptr || *runtimeDir == '\0') return false;
+
+    string base = string(runtimeDir) + "/i3-snapshot-" + hex(fnv1a(session));
+    stateFd = open((base + ".state").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    lockFd = open((base + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (stateFd < 0 || lockFd < 0)
+        throw runtime_error("Unable to open restore state in " + string(runtimeDir) + ": " + strerror(errno));
+    return true;
+}
+
+/**
+ * Wait for the identical restore of generation to finish.
+ * @return FLIGHT_REUSED with its result if it did, FLIGHT_SUPERSEDED if a newer request
+ * came meanwhile, FLIGHT_RUN if it never ran.
+ */
+static FlightRole awaitIdentical(uint64_t generation, size_t &result) {
+    for (int polls = 0; polls < CLAIM_POLLS; polls++) {
+        // The running restore holds the lock exclusively until it is done.
+        lockFile(lockFd, LOCK_SH);
+        lockFile(lockFd, LOCK_UN);
+
+        FlightState state = lockedState(LOCK_SH);
+        if (state.doneGeneration == generation) {
+            result = state.doneResult;
+            return FLIGHT_REUSED;
+        }
+        if (state.generation != generation) return FLIGHT_SUPERSEDED;
+
+        // Announced but not running yet, or gone without a result.
+        this_thread::sleep_for(chrono::milliseconds(CLAIM_POLL_MS));
+    }
+
+    return FLIGHT_RUN;
+}
+
+FlightRole joinFlight(const string &session, const string &key, size_t &result) {
+    if (!openFiles(session)) return FLIGHT_RUN;
+
+    FlightState state = lockedState(LOCK_SH);
+    if (state.key == key && state.generation > state.doneGeneration) {
+        FlightRole role = awaitIdentical(state.generation, result);
+        if (role != FLIGHT_RUN) return role;
+    }
+
+    lockFile(stateFd, LOCK_EX);
+    state = readState();
+    ownGeneration = ++state.generation;
+    state.key = key;
+    writeState(state);
+    lockFile(stateFd, LOCK_UN);
+
+    // An older restore sees the new generation and gives up the lock at its next batch.
+    lockFile(lockFd, LOCK_EX);
+    return flightSuperseded() ? FLIGHT_SUPERSEDED : FLIGHT_RUN;
+}
+
+void finishFlight(size_t result) {
+    if (stateFd < 0) return;
+
+    lockFile(stateFd, LOCK_EX);
+    FlightState state = readState();
+    state.doneGeneration = ownGeneration;
+    state.doneResult = result;
+    writeState(state);
+    lockFile(stateFd, LOCK_UN);
+
+    lockFile(lockFd, LOCK_UN);
+}
+
+bool flightSuperseded() {
+    if (stateFd < 0) return false;
+
+    return lockedState(LOCK_SH).generation != ownGeneration;
+}
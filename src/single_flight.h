@@ -0,0 +1,85 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_SINGLE_FLIGHT_H
+#define I3_SNAPSHOT_SINGLE_FLIGHT_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Coordination of restores started at the same time, e.g. by a hotplug hook and a key
+ * binding, through two files in $XDG_RUNTIME_DIR per i3 session: a lock held by the restore
+ * that is running, and a small state file naming the latest request and the last result.
+ * Without $XDG_RUNTIME_DIR every restore just runs.
+ */
+
+/**
+ * Outcome of joining the restores of a session.
+ */
+enum FlightRole {
+    // This process holds the restore lock and runs its restore.
+    FLIGHT_RUN,
+    // An identical restore ran meanwhile; its result is to be used.
+    FLIGHT_REUSED,
+    // A newer, different restore was requested meanwhile and takes over.
+    FLIGHT_SUPERSEDED
+};
+
+/**
+ * Identify a restore request.
+ * @param input the snapshot being restored
+ * @param variant mode and options that change what the restore does
+ * @return key equal for identical requests.
+ */
+std::string flightKey(const std::string &input, const std::string &variant);
+
+/**
+ * Wait for a turn to restore.  A request identical to the latest one waits for it and takes
+ * its result.  Any other request announces itself, which makes a running restore stop at
+ * its next batch, and then waits for the restore lock.
+ * @param session i3 socket path, restores of different sessions do not interact
+ * @param key result of flightKey()
+ * @param result receives the result of the identical restore with FLIGHT_REUSED
+ */
+FlightRole joinFlight(const std::string &session, const std::string &key, size_t &result);
+
+/**
+ * Record the result of this process's restore and release the restore lock.
+ */
+void finishFlight(size_t result);
+
+/**
+ * @return true if a newer request has been made since this process joined, so that its
+ * restore should stop at the next batch boundary.  Always false outside a flight.
+ */
+bool flightSuperseded();
+
+#endif //I3_SNAPSHOT_SINGLE_FLIGHT_H
@@ -0,0 +1,375 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "snapshot.h"
+
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "base64.h"
+#include "con_index.h"
+#include "deadline.h"
+#include "service.h"
+#include "tree_stats.h"
+
+using namespace std;
+
+CommandLineOptions defaultOptions() {
+    CommandLineOptions options{};
+
+    options.debug = false;
+    options.failFast = true;
+    options.forceOutputMode = false;
+    options.encodeStrings = true;
+    options.dryRun = false;
+    options.printPlan = false;
+    options.planScript = false;
+    options.lazy = false;
+    options.layout = false;
+    options.emitRules = false;
+    options.marks = false;
+    options.unmark = false;
+    options.script = false;
+    options.resident = false;
+    options.treeStats = false;
+    options.mergePolicy = MERGE_LATEST;
+    options.fsyncOut = false;
+    options.lazyIdleMs = DEFAULT_LAZY_IDLE_MS;
+    options.settleQuietMs = 0;
+    options.outputsQuietMs = 0;
+    options.runTimeoutMs = DEFAULT_RUN_TIMEOUT_MS;
+    options.phaseTimeoutMs = 0;
+    options.requestTimeoutMs = DEFAULT_REQUEST_TIMEOUT_MS;
+    options.serviceQuotaBytes = DEFAULT_SERVICE_QUOTA_BYTES;
+    options.windowIdentifier = I3_ID;
+
+    return options;
+}
+
+bool isWindow(const i3ipc::container_t &c) {
+    return c.type == "con" && c.xwindow_id != 0;
+}
+
+bool isValidParent(const i3ipc::container_t &c) {
+    return c.type != "dockarea";
+}
+
+void findWindows(const i3ipc::container_t &c, TreeState &treeState, Snapshot &snapshot) {
+    TreeStats *stats = treeState.stats;
+    uint64_t windowsBefore = 0;
+    if (stats != nullptr) {
+        stats->addContainer(treeState.depth, c.nodes.size() + c.floating_nodes.size());
+        windowsBefore = stats->windows;
+    }
+
+    if (c.type == "output") {
+        treeState.outputName = c.name;
+        treeState.internal = c.name == "__i3";
+        if (stats != nullptr) stats->outputs++;
+    } else if (c.type == "workspace") {
+        treeState.workspaceName = c.name;
+        treeState.workspaceId = c.id;
+        if (stats != nullptr) stats->workspaces++;
+    } else if (isWindow(c)) {
+        if (treeState.outputName.empty() || treeState.workspaceName.empty())
+            throw runtime_error("Invalid tree state, aborting.");
+
+        bool scratchpad = treeState.workspaceName == SCRATCHPAD_WORKSPACE;
+        if (treeState.internal && !scratchpad) return;
+
+        WindowRecord record;
+        record.outputName = treeState.outputName;
+        record.workspaceName = treeState.workspaceName;
+        record.workspaceId = treeState.workspaceId;
+        record.windowId = c.id;
+        record.windowName = c.name;
+        if (treeState.markWindows) record.mark = windowMark(c.xwindow_id);
+        record.placement = scratchpad ? PLACEMENT_SCRATCHPAD : treeState.floating ? PLACEMENT_FLOATING : PLACEMENT_TILING;
+        if (stats != nullptr) stats->addWindow(record.windowName, record.placement);
+        snapshot.push_back(move(record));
+    }
+
+    if (isValidParent(c)) {
+        treeState.depth++;
+        for (auto &node : c.nodes)
+            findWindows(*node, treeState, snapshot);
+
+        bool floating = treeState.floating;
+        treeState.floating = true;
+        for (auto &node : c.floating_nodes)
+            findWindows(*node, treeState, snapshot);
+        treeState.floating = floating;
+        treeState.depth--;
+    }
+
+    if (stats != nullptr && c.type == "workspace") stats->windowsPerWorkspace.add(stats->windows - windowsBefore);
+}
+
+string windowMark(uint64_t xwindowId) {
+    return SNAPSHOT_MARK_PREFIX + to_string(xwindowId);
+}
+
+uint64_t markedXWindow(const string &mark) {
+    size_t prefix = sizeof(SNAPSHOT_MARK_PREFIX) - 1;
+    if (mark.compare(0, prefix, SNAPSHOT_MARK_PREFIX) != 0 || mark.size() == prefix) return 0;
+
+    uint64_t xwindowId = 0;
+    for (size_t i = prefix; i < mark.size(); i++) {
+        if (!isdigit(static_cast<unsigned char>(mark[i]))) return 0;
+        xwindowId = xwindowId * 10 + static_cast<uint64_t>(mark[i] - '0');
+    }
+    return xwindowId;
+}
+
+Snapshot captureSnapshot(const i3ipc::connection &i3conn, bool markWindows, TreeStats *stats) {
+    Snapshot snapshot;
+    TreeState treeState;
+    treeState.markWindows = markWindows;
+    treeState.stats = stats;
+
+    beginPhase("capture");
+    armRequest();
+    findWindows(*i3conn.get_tree(), treeState, snapshot);
+
+    return snapshot;
+}
+
+/**
+ * Append a name in the raw format: backslash, tab and newline become \\, \t and \n.
+ */
+static void appendEscaped(string &out, const string &value) {
+    for (char c : value) {
+        if (c == '\\') out += "\\\\";
+        else if (c == '\t') out += "\\t";
+        else if (c == '\n') out += "\\n";
+        else out += c;
+    }
+}
+
+/**
+ * Decode a name of the raw format.  Runs without escapes, the common case, are found with
+ * memchr and copied whole.
+ * @throws std::invalid_argument on an unknown or incomplete escape.
+ */
+static void unescapeField(const char *begin, const char *end, string &out) {
+    out.clear();
+
+    while (true) {
+        auto escape = static_cast<const char *>(memchr(begin, '\\', static_cast<size_t>(end - begin)));
+        if (escape == nullptr) {
+            out.append(begin, end);
+            return;
+        }
+
+        out.append(begin, escape);
+        char escaped = escape + 1 < end ? escape[1] : '\0';
+        if (escaped == 't') out += '\t';
+        else if (escaped == 'n') out += '\n';
+        else if (escaped == '\\') out += '\\';
+        else throw invalid_argument("Invalid escape in snapshot field: '" + string(begin, end) + "'");
+        begin = escape + 2;
+    }
+}
+
+/**
+ * Write the optional key=value fields of a record, each preceded by separator.
+ */
+static void appendOptionalFields(string &out, const WindowRecord &record, char separator) {
+    // Tiling windows need none.
+    if (record.placement != PLACEMENT_TILING) {
+        out += separator;
+        out += record.placement == PLACEMENT_FLOATING ? "placement=floating" : "placement=scratchpad";
+    }
+    if (!record.mark.empty()) {
+        out += separator;
+        out += "mark=" + record.mark;
+    }
+}
+
+/**
+ * Apply one optional key=value field to a record.  Unknown fields are skipped so that
+ * newer snapshots still load.
+ */
+static void parseOptionalField(const char *begin, const char *end, WindowRecord &record) {
+    size_t length = static_cast<size_t>(end - begin);
+
+    if (length == 18 && memcmp(begin, "placement=floating", 18) == 0) record.placement = PLACEMENT_FLOATING;
+    else if (length == 20 && memcmp(begin, "placement=scratchpad", 20) == 0) record.placement = PLACEMENT_SCRATCHPAD;
+    else if (length > 5 && memcmp(begin, "mark=", 5) == 0) record.mark.assign(begin + 5, end);
+}
+
+void writeSnapshot(ostream &out, const Snapshot &snapshot, bool encodeStrings) {
+    string line;
+
+    for (auto &record : snapshot) {
+        line.clear();
+
+        // Output Name, Workspace Name, Workspace Id, Window Id, Window Name
+        if (encodeStrings) {
+            line += base64_encode(reinterpret_cast<const unsigned char *>(record.outputName.c_str()),
+                                  record.outputName.length());
+            line += ' ';
+            line += base64_encode(reinterpret_cast<const unsigned char *>(record.workspaceName.c_str()),
+                                  record.workspaceName.length());
+            line += ' ';
+            line += to_string(record.workspaceId);
+            line += ' ';
+            line += to_string(record.windowId);
+            line += ' ';
+            line += base64_encode(reinterpret_cast<const unsigned char *>(record.windowName.c_str()),
+                                  record.windowName.length());
+            appendOptionalFields(line, record, ' ');
+        } else {
+            // Raw names are separated by tabs, which base64 never contains.
+            appendEscaped(line, record.outputName);
+            line += '\t';
+            appendEscaped(line, record.workspaceName);
+            line += '\t';
+            line += to_string(record.workspaceId);
+            line += '\t';
+            line += to_string(record.windowId);
+            line += '\t';
+            appendEscaped(line, record.windowName);
+            appendOptionalFields(line, record, '\t');
+        }
+
+        line += '\n';
+        out.write(line.data(), static_cast<streamsize>(line.size()));
+    }
+    out.flush();
+}
+
+/**
+ * Parse a line of the raw format: tab separated, names escaped by appendEscaped().
+ */
+static void parseRawSnapshotLine(const string &line, WindowRecord &record) {
+    const char *begin = line.data();
+    const char *end = begin + line.size();
+    const char *fields[5][2];
+
+    for (auto &field : fields) {
+        if (begin > end) throw invalid_argument("Truncated snapshot line: '" + line + "'");
+
+        auto tab = static_cast<const char *>(memchr(begin, '\t', static_cast<size_t>(end - begin)));
+        field[0] = begin;
+        field[1] = tab != nullptr ? tab : end;
+        begin = field[1] + 1;
+    }
+
+    unescapeField(fields[0][0], fields[0][1], record.outputName);
+    unescapeField(fields[1][0], fields[1][1], record.workspaceName);
+    record.workspaceId = stoul(string(fields[2][0], fields[2][1]));
+    record.windowId = stoul(string(fields[3][0], fields[3][1]));
+    unescapeField(fields[4][0], fields[4][1], record.windowName);
+
+    record.placement = PLACEMENT_TILING;
+    record.mark.clear();
+
+    while (begin < end) {
+        auto tab = static_cast<const char *>(memchr(begin, '\t', static_cast<size_t>(end - begin)));
+        const char *fieldEnd = tab != nullptr ? tab : end;
+        parseOptionalField(begin, fieldEnd, record);
+        begin = fieldEnd + 1;
+    }
+}
+
+bool parseSnapshotLine(const string &line, WindowRecord &record) {
+    if (line.find_first_not_of(" \t\r") == string::npos) return false;
+
+    if (memchr(line.data(), '\t', line.size()) != nullptr) {
+        parseRawSnapshotLine(line, record);
+        return true;
+    }
+
+    istringstream fields(line);
+    string outputNameEnc, workspaceNameEnc, workspaceIdStr, windowIdStr, windowNameEnc, field;
+
+    if (!(fields >> outputNameEnc >> workspaceNameEnc >> workspaceIdStr >> windowIdStr))
+        throw invalid_argument("Truncated snapshot line: '" + line + "'");
+
+    // An empty window name encodes to nothing, so an optional field may come right after
+    // the window id.  Base64 only has '=' as trailing padding, unlike key=value.
+    if (fields >> field) {
+        size_t equals = field.find('=');
+        if (equals == string::npos || equals + 1 == field.size() || field[equals + 1] == '=') {
+            windowNameEnc.swap(field);
+            field.clear();
+        }
+    }
+
+    record.outputName = base64_decode(outputNameEnc);
+    record.workspaceName = base64_decode(workspaceNameEnc);
+    record.workspaceId = stoul(workspaceIdStr);
+    record.windowName = base64_decode(windowNameEnc);
+    record.windowId = stoul(windowIdStr);
+
+    // Snapshots of older versions recorded scratchpad windows under their workspace only.
+    record.placement = record.workspaceName == SCRATCHPAD_WORKSPACE ? PLACEMENT_SCRATCHPAD : PLACEMENT_TILING;
+    record.mark.clear();
+
+    if (!field.empty()) parseOptionalField(field.data(), field.data() + field.size(), record);
+    while (fields >> field)
+        parseOptionalField(field.data(), field.data() + field.size(), record);
+
+    return true;
+}
+
+Snapshot readSnapshot(istream &in) {
+    Snapshot snapshot;
+    string line;
+    WindowRecord record;
+
+    while (getline(in, line))
+        if (parseSnapshotLine(line, record))
+            snapshot.push_back(record);
+
+    return snapshot;
+}
+
+Snapshot diffSnapshots(const Snapshot &saved, const Snapshot &live) {
+    FlatIdMap liveById(live.size());
+    for (size_t i = 0; i < live.size(); i++)
+        liveById.insert(live[i].windowId, static_cast<uint32_t>(i));
+
+    Snapshot changed;
+    for (auto &record : saved) {
+        uint32_t found = liveById.find(record.windowId);
+        if (found == FlatIdMap::NOT_FOUND) continue;
+
+        const WindowRecord &current = live[found];
+        if (current.workspaceId != record.workspaceId || current.outputName != record.outputName)
+            changed.push_back(record);
+    }
+
+    return changed;
+}
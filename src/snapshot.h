@@ -0,0 +1,235 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_SNAPSHOT_H
+#define I3_SNAPSHOT_SNAPSHOT_H
+
+#include <i3ipc++/ipc.hpp>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+struct TreeStats;
+
+/**
+ * Keep track of output and workspace as the i3 container tree is traversed depth-first.
+ */
+struct TreeState {
+    std::string outputName;
+    std::string workspaceName;
+    size_t workspaceId{};
+    // Inside the __i3 pseudo output holding i3's own containers.
+    bool internal{};
+    // Below the floating_nodes of a workspace.
+    bool floating{};
+    // Give each record the snapshot mark of its window.
+    bool markWindows{};
+    // Depth of the container being visited, the root being 0.
+    uint16_t depth{};
+    // Receives the shape of the tree if set.
+    TreeStats *stats{};
+};
+
+/**
+ * Prefix of the marks identifying windows across i3 restarts.  Marks starting with an
+ * underscore are not drawn by i3.
+ */
+const char SNAPSHOT_MARK_PREFIX[] = "_snap:";
+
+/**
+ * Workspace of the __i3 output holding the scratchpad.
+ */
+const char SCRATCHPAD_WORKSPACE[] = "__i3_scratch";
+
+/**
+ * How a window is held by its workspace.
+ */
+enum WindowPlacement {
+    PLACEMENT_TILING, PLACEMENT_FLOATING, PLACEMENT_SCRATCHPAD
+};
+
+enum WindowIdentifier {
+    I3_ID, WINDOW_TITLE
+};
+
+/**
+ * Which record is kept when several snapshots place the same window.
+ */
+enum MergePolicy {
+    // The record of the most recent snapshot.
+    MERGE_LATEST,
+    // The record of the snapshot owning the output it places the window on, that is the most
+    // recent snapshot with windows on that output.  Falls back to MERGE_LATEST.
+    MERGE_OUTPUT_OWNER
+};
+
+/**
+ * Default time without workspace events after which one deferred workspace is restored.
+ */
+const int DEFAULT_LAZY_IDLE_MS = 500;
+
+struct CommandLineOptions {
+    bool debug;
+    bool failFast;
+    bool forceOutputMode;
+    bool encodeStrings;
+    bool dryRun;
+    bool printPlan;
+    bool planScript;
+    bool lazy;
+    bool layout;
+    bool emitRules;
+    bool marks;
+    bool unmark;
+    bool script;
+    bool resident;
+    bool treeStats;
+    std::vector<std::string> scriptOperations;
+    std::vector<std::string> mergePaths;
+    MergePolicy mergePolicy;
+    int lazyIdleMs;
+    int settleQuietMs;
+    int outputsQuietMs;
+    std::string eventLogPath;
+    std::string outPath;
+    bool fsyncOut;
+    int runTimeoutMs;
+    int phaseTimeoutMs;
+    int requestTimeoutMs;
+    std::string socketPath;
+    std::string servicePath;
+    size_t serviceQuotaBytes;
+    WindowIdentifier windowIdentifier;
+};
+
+/**
+ * One line of a snapshot: where a single window lives.
+ */
+struct WindowRecord {
+    std::string outputName;
+    std::string workspaceName;
+    size_t workspaceId{};
+    size_t windowId{};
+    std::string windowName;
+    WindowPlacement placement{PLACEMENT_TILING};
+    // Snapshot mark of the window, empty if the snapshot was taken without marks.
+    std::string mark;
+};
+
+typedef std::vector<WindowRecord> Snapshot;
+
+/**
+ * @return options with the defaults used when no command line flags are given.
+ */
+CommandLineOptions defaultOptions();
+
+/**
+ * Determine if the i3 container is a window type.
+ * @param c i3 container
+ * @return true if container is window, false otherwise.
+ */
+bool isWindow(const i3ipc::container_t &c);
+
+/**
+ * Determine if container should not be ignored.
+ * @param c i3 container
+ * @return true if container is valid, false otherwise.
+ */
+bool isValidParent(const i3ipc::container_t &c);
+
+/**
+ * Traverse i3 containers and record every window found, tiling and floating ones as well
+ * as those in the scratchpad.  Other containers of the __i3 pseudo output are skipped.
+ *
+ * @param c i3 container
+ * @param treeState storage of current state of tree traversal, and of tree statistics if
+ * its stats are set.
+ * @param snapshot receives one record per window, in tree order.
+ * @throws std::runtime_error if a window is found outside of an output and workspace.
+ */
+void findWindows(const i3ipc::container_t &c, TreeState &treeState, Snapshot &snapshot);
+
+/**
+ * @return the snapshot mark of a window.  It is derived from the X window id, which
+ * survives an i3 restart, so capturing again gives a window the same mark.
+ */
+std::string windowMark(uint64_t xwindowId);
+
+/**
+ * @return the X window id a snapshot mark was derived from, or 0 if it is none.
+ */
+uint64_t markedXWindow(const std::string &mark);
+
+/**
+ * Read the current window placement from i3.
+ * @param i3conn i3 connection
+ * @param markWindows record the snapshot mark of every window, see windowMark().
+ * @param stats if set, receives the shape of the tree, gathered in the same traversal.
+ * @return records of all windows in the tree.
+ */
+Snapshot captureSnapshot(const i3ipc::connection &i3conn, bool markWindows = false, TreeStats *stats = nullptr);
+
+/**
+ * Write a snapshot in the line format read by readSnapshot().  Records of windows that
+ * are not tiling end in a placement=floating or placement=scratchpad field, and those
+ * with a mark in a mark=... field.
+ * @param out destination stream
+ * @param snapshot records to write
+ * @param encodeStrings base64 encode names and separate fields by spaces if true.  Otherwise
+ * fields are separated by tabs and names written verbatim, with backslash, tab and newline
+ * escaped as \\, \t and \n.  readSnapshot() recognizes the raw format by its tabs.
+ */
+void writeSnapshot(std::ostream &out, const Snapshot &snapshot, bool encodeStrings);
+
+/**
+ * Parse one snapshot line.
+ * @param line text of the line without the trailing newline
+ * @param record receives the parsed values
+ * @return true if the line held a record, false if it was blank.
+ * @throws std::invalid_argument if the line is malformed.
+ */
+bool parseSnapshotLine(const std::string &line, WindowRecord &record);
+
+/**
+ * Read all records from a snapshot stream.
+ * @param in source stream
+ * @return the parsed records in file order.
+ */
+Snapshot readSnapshot(std::istream &in);
+
+/**
+ * Compare a saved snapshot against the live placement of the same windows.
+ * @param saved previously captured snapshot
+ * @param live snapshot of the current tree
+ * @return the saved records of windows that exist in both but are placed differently.
+ */
+Snapshot diffSnapshots(const Snapshot &saved, const Snapshot &live);
+
+#endif //I3_SNAPSHOT_SNAPSHOT_H
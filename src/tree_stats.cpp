@@ -0,0 +1,76 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tree_stats.h"
+
+#include <iomanip>
+#include <ostream>
+
+using namespace std;
+
+static void writeHistogram(ostream &out, const char *name, const Histogram &histogram) {
+    out << "  \"" << name << "\": {\"count\": " << histogram.count << ", \"mean\": " << fixed << setprecision(2)
+        << (histogram.count > 0 ? static_cast<double>(histogram.sum) / histogram.count : 0.0)
+        << ", \"max\": " << histogram.max << ", \"buckets\": [";
+
+    bool first = true;
+    for (size_t i = 0; i < histogram.buckets.size(); i++) {
+        if (histogram.buckets[i] == 0) continue;
+
+        uint64_t low = i == 0 ? 0 : uint64_t(1) << (i - 1);
+        uint64_t high = i == 0 ? 0 : i == 64 ? UINT64_MAX : (uint64_t(1) << i) - 1;
+        out << (first ? "" : ", ") << "{\"min\": " << low << ", \"max\": " << high << ", \"count\": "
+            << histogram.buckets[i] << "}";
+        first = false;
+    }
+
+    out << "]}";
+}
+
+void writeTreeStats(ostream &out, const TreeStats &stats) {
+    out << "{\n"
+        << "  \"containers\": " << stats.containers << ",\n"
+        << "  \"outputs\": " << stats.outputs << ",\n"
+        << "  \"workspaces\": " << stats.workspaces << ",\n"
+        << "  \"windows\": " << stats.windows << ",\n"
+        << "  \"floating_windows\": " << stats.floatingWindows << ",\n"
+        << "  \"scratchpad_windows\": " << stats.scratchpadWindows << ",\n"
+        << "  \"max_depth\": " << stats.depth.max << ",\n"
+        << "  \"max_fan_out\": " << stats.fanOut.max << ",\n";
+
+    writeHistogram(out, "depth", stats.depth);
+    out << ",\n";
+    writeHistogram(out, "fan_out", stats.fanOut);
+    out << ",\n";
+    writeHistogram(out, "windows_per_workspace", stats.windowsPerWorkspace);
+    out << ",\n";
+    writeHistogram(out, "title_length", stats.titleLength);
+    out << "\n}" << endl;
+}
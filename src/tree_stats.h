@@ -0,0 +1,99 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_TREE_STATS_H
+#define I3_SNAPSHOT_TREE_STATS_H
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+#include "snapshot.h"
+
+/**
+ * Distribution of a non-negative quantity in power-of-two buckets: bucket 0 counts 0,
+ * bucket k counts values from 2^(k-1) to 2^k - 1.  Adding a value is a few instructions.
+ */
+struct Histogram {
+    std::array<uint64_t, 65> buckets{};
+    uint64_t count{};
+    uint64_t sum{};
+    uint64_t max{};
+
+    void add(uint64_t value) {
+        buckets[value == 0 ? 0 : 64 - __builtin_clzll(value)]++;
+        count++;
+        sum += value;
+        if (value > max) max = value;
+    }
+};
+
+/**
+ * Shape of an i3 tree, gathered by findWindows() while it records windows.
+ */
+struct TreeStats {
+    uint64_t containers{};
+    uint64_t outputs{};
+    uint64_t workspaces{};
+    uint64_t windows{};
+    uint64_t floatingWindows{};
+    uint64_t scratchpadWindows{};
+    // Depth of every container, the root being 0.
+    Histogram depth;
+    // Children, tiling and floating, of every container that has any.
+    Histogram fanOut;
+    Histogram windowsPerWorkspace;
+    // Window title length in bytes.
+    Histogram titleLength;
+
+    void addContainer(uint16_t depth, size_t children) {
+        containers++;
+        this->depth.add(depth);
+        if (children > 0) fanOut.add(children);
+    }
+
+    void addWindow(const std::string &title, WindowPlacement placement) {
+        windows++;
+        if (placement == PLACEMENT_FLOATING) floatingWindows++;
+        else if (placement == PLACEMENT_SCRATCHPAD) scratchpadWindows++;
+        titleLength.add(title.size());
+    }
+};
+
+/**
+ * Write tree statistics as a JSON object.  Each histogram lists its non-empty buckets
+ * with their bounds, along with the count, mean and maximum of its values.
+ * @param out destination stream
+ * @param stats statistics to write
+ */
+void writeTreeStats(std::ostream &out, const TreeStats &stats);
+
+#endif //I3_SNAPSHOT_TREE_STATS_H
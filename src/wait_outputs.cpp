@@ -0,0 +1,112 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "wait_outputs.h"
+
+#include <cerrno>
+#include <poll.h>
+#include <sstream>
+
+#include "deadline.h"
+#include "event_log.h"
+
+using namespace std;
+
+/**
+ * Interval at which outputs are polled when i3 sends no events.
+ */
+static const int OUTPUTS_POLL_MS = 100;
+
+/**
+ * @return a description of the outputs that changes whenever one of them does.
+ */
+static string outputsSignature(const vector<shared_ptr<i3ipc::output_t>> &outputs) {
+    ostringstream signature;
+    for (auto &output : outputs)
+        signature << output->name << ' ' << output->active << ' ' << output->rect.x << ',' << output->rect.y << ' '
+                  << output->rect.width << 'x' << output->rect.height << ';';
+    return signature.str();
+}
+
+/**
+ * @return the number of wanted outputs that are active.
+ */
+static size_t countActive(const vector<shared_ptr<i3ipc::output_t>> &outputs, const set<string> &wanted) {
+    size_t active = 0;
+    for (auto &output : outputs)
+        if (output->active && wanted.count(output->name) > 0) active++;
+    return active;
+}
+
+set<string> snapshotOutputs(const Snapshot &snapshot) {
+    set<string> outputs;
+    for (auto &record : snapshot)
+        if (record.placement != PLACEMENT_SCRATCHPAD) outputs.insert(record.outputName);
+    return outputs;
+}
+
+bool waitForOutputs(i3ipc::connection &i3conn, const set<string> &wanted, int quietMs) {
+    beginPhase("wait-outputs");
+    i3conn.subscribe(i3ipc::ET_OUTPUT);
+    i3conn.prepare_to_event_handling();
+
+    uint64_t quietNs = static_cast<uint64_t>(quietMs) * 1000000u;
+    uint64_t deadline = eventClockNs() + static_cast<uint64_t>(MAX_OUTPUTS_WAIT_MS) * 1000000u;
+    uint64_t changedNs = eventClockNs();
+    string signature;
+    pollfd events{i3conn.get_event_socket_fd(), POLLIN, 0};
+
+    while (true) {
+        armRequest();
+        auto outputs = i3conn.get_outputs();
+        uint64_t now = eventClockNs();
+
+        size_t active = countActive(outputs, wanted);
+        bool ready = active == wanted.size();
+
+        string current = outputsSignature(outputs);
+        if (current != signature) {
+            signature = current;
+            changedNs = now;
+            logEvent(EV_OUTPUTS, ready, static_cast<uint32_t>(outputs.size()), active);
+        }
+
+        if (ready && now - changedNs >= quietNs) return true;
+        if (now >= deadline) return false;
+
+        // Wake up on the next output event or poll again shortly, whichever comes first.
+        uint64_t wakeNs = min(deadline, now + static_cast<uint64_t>(OUTPUTS_POLL_MS) * 1000000u);
+        if (ready) wakeNs = min(wakeNs, changedNs + quietNs);
+
+        int polled = poll(&events, 1, static_cast<int>((wakeNs - now + 999999) / 1000000));
+        if (polled > 0 && (events.revents & POLLIN)) i3conn.handle_event();
+        else if (polled < 0 && errno != EINTR) return false;
+    }
+}
@@ -0,0 +1,66 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_WAIT_OUTPUTS_H
+#define I3_SNAPSHOT_WAIT_OUTPUTS_H
+
+#include <i3ipc++/ipc.hpp>
+#include <set>
+#include <string>
+
+#include "snapshot.h"
+
+/**
+ * Default time the outputs must stay unchanged before a restore starts.
+ */
+const int DEFAULT_OUTPUTS_QUIET_MS = 500;
+
+/**
+ * Longest wait for outputs to settle.
+ */
+const int MAX_OUTPUTS_WAIT_MS = 10000;
+
+/**
+ * Wait for i3 to finish reconfiguring outputs, e.g. after a monitor was plugged in.
+ * Output events are subscribed to and GET_OUTPUTS is polled until every wanted output is
+ * active and no output changed name, state or geometry for quietMs.
+ * @param i3conn i3 connection, also used to subscribe to output events
+ * @param wanted outputs the restore needs
+ * @param quietMs quiet period
+ * @return true once settled, false if MAX_OUTPUTS_WAIT_MS passed first.
+ */
+bool waitForOutputs(i3ipc::connection &i3conn, const std::set<std::string> &wanted, int quietMs);
+
+/**
+ * @return the outputs windows of a snapshot are placed on.
+ */
+std::set<std::string> snapshotOutputs(const Snapshot &snapshot);
+
+#endif //I3_SNAPSHOT_WAIT_OUTPUTS_H
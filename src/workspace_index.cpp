@@ -0,0 +1,183 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "workspace_index.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+/**
+ * Sentinel for keys shared by more than one workspace, which must not match anything.
+ */
+static const size_t AMBIGUOUS = static_cast<size_t>(-1);
+
+template<typename Key>
+static void addUnique(unordered_map<Key, size_t> &index, const Key &key, size_t position) {
+    auto inserted = index.emplace(key, position);
+    if (!inserted.second && inserted.first->second != position) inserted.first->second = AMBIGUOUS;
+}
+
+WorkspaceIndex::WorkspaceIndex(const i3ipc::container_t &tree,
+                               const vector<shared_ptr<i3ipc::workspace_t>> &workspaceList, bool matchIds)
+        : matchIds(matchIds) {
+    addWorkspaces(tree, "");
+
+    for (auto &workspace : workspaceList) {
+        auto found = byName.find(workspace->name);
+        if (found == byName.end() || found->second == AMBIGUOUS) continue;
+
+        LiveWorkspace &live = workspaces[found->second];
+        live.num = workspace->num;
+        live.visible = workspace->visible;
+        live.focused = workspace->focused;
+    }
+
+    for (size_t i = 0; i < workspaces.size(); i++) {
+        if (workspaces[i].num >= 0) addUnique(byNumber, workspaces[i].num, i);
+        addUnique(byStrippedName, stripMarkup(workspaces[i].name), i);
+    }
+}
+
+void WorkspaceIndex::addWorkspaces(const i3ipc::container_t &c, const string &outputName) {
+    if (c.type == "workspace") {
+        LiveWorkspace live;
+        live.id = c.id;
+        live.name = c.name;
+        live.num = workspaceNumber(c.name);
+        live.outputName = outputName;
+
+        byId[live.id] = workspaces.size();
+        addUnique(byName, live.name, workspaces.size());
+        workspaces.push_back(live);
+        return;
+    }
+
+    for (auto &node : c.nodes)
+        addWorkspaces(*node, c.type == "output" ? c.name : outputName);
+}
+
+const LiveWorkspace *WorkspaceIndex::findById(size_t workspaceId) const {
+    auto found = byId.find(workspaceId);
+    return found == byId.end() ? nullptr : &workspaces[found->second];
+}
+
+const LiveWorkspace *WorkspaceIndex::resolve(size_t workspaceId, const string &workspaceName) const {
+    string key = to_string(workspaceId) + ":" + workspaceName;
+    auto cached = resolved.find(key);
+    if (cached != resolved.end()) return cached->second;
+
+    const LiveWorkspace *match = matchIds && workspaceId != 0 ? findById(workspaceId) : nullptr;
+
+    auto lookup = [this](const auto &index, const auto &value) -> const LiveWorkspace * {
+        auto found = index.find(value);
+        if (found == index.end() || found->second == AMBIGUOUS) return nullptr;
+        return &workspaces[found->second];
+    };
+
+    if (match == nullptr) match = lookup(byName, workspaceName);
+
+    int number = workspaceNumber(workspaceName);
+    if (match == nullptr && number >= 0) match = lookup(byNumber, number);
+
+    if (match == nullptr) {
+        string stripped = stripMarkup(workspaceName);
+        if (!stripped.empty()) match = lookup(byStrippedName, stripped);
+    }
+
+    resolved.emplace(key, match);
+    return match;
+}
+
+string WorkspaceIndex::stripMarkup(const string &name) {
+    string stripped;
+    stripped.reserve(name.size());
+
+    bool inTag = false;
+    bool pendingSpace = false;
+
+    for (size_t i = 0; i < name.size(); i++) {
+        unsigned char c = name[i];
+
+        if (inTag) {
+            if (c == '>') inTag = false;
+            continue;
+        }
+        if (c == '<') {
+            inTag = true;
+            continue;
+        }
+
+        // U+E000..U+F8FF (EF 80 80 .. EF A3 BF) and planes 15/16 (F3 B0.., F4 ..) are icon fonts.
+        if (c == 0xEE || (c == 0xEF && i + 1 < name.size() && static_cast<unsigned char>(name[i + 1]) <= 0xA3)) {
+            i += 2;
+            continue;
+        }
+        if (c == 0xF4 || (c == 0xF3 && i + 1 < name.size() && static_cast<unsigned char>(name[i + 1]) >= 0xB0)) {
+            i += 3;
+            continue;
+        }
+
+        if (c == '&') {
+            static const pair<const char *, char> entities[] = {
+                    {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''}};
+            for (auto &entity : entities) {
+                if (name.compare(i, strlen(entity.first), entity.first) == 0) {
+                    c = entity.second;
+                    i += strlen(entity.first) - 1;
+                    break;
+                }
+            }
+        }
+
+        if (isspace(c)) {
+            pendingSpace = !stripped.empty();
+            continue;
+        }
+
+        if (pendingSpace) stripped += ' ';
+        pendingSpace = false;
+        stripped += static_cast<char>(c);
+    }
+
+    return stripped;
+}
+
+int WorkspaceIndex::workspaceNumber(const string &name) {
+    // i3 takes the leading decimal digits of a name, ignoring leading whitespace.
+    size_t start = 0;
+    while (start < name.size() && isspace(static_cast<unsigned char>(name[start]))) start++;
+
+    if (start == name.size() || !isdigit(static_cast<unsigned char>(name[start]))) return -1;
+
+    return atoi(name.c_str() + start);
+}
@@ -0,0 +1,100 @@
+/*
+    Copyright (c) 2019, Ken Gilmer
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    1. Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+    3. All advertising materials mentioning features or use of this software
+       must display the following acknowledgement:
+       This product includes software developed by Ken Gilmer.
+    4. Neither the name of Ken Gilmer nor the
+       names of its contributors may be used to endorse or promote products
+       derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I3_SNAPSHOT_WORKSPACE_INDEX_H
+#define I3_SNAPSHOT_WORKSPACE_INDEX_H
+
+#include <i3ipc++/ipc.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * A workspace of the live tree.
+ */
+struct LiveWorkspace {
+    size_t id{};
+    int num{-1};
+    std::string name;
+    std::string outputName;
+    bool visible{};
+    bool focused{};
+};
+
+/**
+ * Lookup of live workspaces for snapshot workspaces whose names may have changed since
+ * capture, e.g. Regolith names carrying Pango markup and icons of the windows inside.
+ * A snapshot workspace is matched, in order, by con_id, full name, workspace number
+ * and markup-stripped name.  Each snapshot workspace is resolved once and cached.
+ */
+class WorkspaceIndex {
+public:
+    /**
+     * @param tree root of the live i3 tree
+     * @param workspaces reply to GET_WORKSPACES for visibility, focus and numbers.
+     * @param matchIds allow matching by con_id; ids are only meaningful within one i3 session.
+     */
+    WorkspaceIndex(const i3ipc::container_t &tree,
+                   const std::vector<std::shared_ptr<i3ipc::workspace_t>> &workspaces, bool matchIds);
+
+    /**
+     * @return the live workspace for a snapshot workspace, or nullptr if none matches.
+     */
+    const LiveWorkspace *resolve(size_t workspaceId, const std::string &workspaceName) const;
+
+    /**
+     * @return the live workspace with the given con_id, or nullptr.
+     */
+    const LiveWorkspace *findById(size_t workspaceId) const;
+
+    /**
+     * Remove Pango markup and private use area icon glyphs, collapse whitespace.
+     */
+    static std::string stripMarkup(const std::string &name);
+
+    /**
+     * @return the number i3 derives from a workspace name, or -1 if it has none.
+     */
+    static int workspaceNumber(const std::string &name);
+
+private:
+    void addWorkspaces(const i3ipc::container_t &c, const std::string &outputName);
+
+    std::vector<LiveWorkspace> workspaces;
+    std::unordered_map<size_t, size_t> byId;
+    std::unordered_map<std::string, size_t> byName;
+    std::unordered_map<int, size_t> byNumber;
+    std::unordered_map<std::string, size_t> byStrippedName;
+    bool matchIds;
+
+    mutable std::unordered_map<std::string, const LiveWorkspace *> resolved;
+};
+
+#endif //I3_SNAPSHOT_WORKSPACE_INDEX_H
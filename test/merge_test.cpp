@@ -0,0 +1,81 @@
+/*
+ * Merging snapshots: window identity across marked and unmarked records, the merge
+ * policies, and a merged snapshot surviving the line format.
+ *
+ * Usage: merge_test
+ */
+
+#include <cstdio>
+#include <sstream>
+
+#include "merge.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool passed, const char *what) {
+    if (passed) return;
+    fprintf(stderr, "FAIL: %s\n", what);
+    failures++;
+}
+
+static WindowRecord makeRecord(const string &outputName, const string &workspaceName, size_t windowId,
+                               const string &mark = "") {
+    WindowRecord record;
+    record.outputName = outputName;
+    record.workspaceName = workspaceName;
+    record.workspaceId = 1000 + windowId;
+    record.windowId = windowId;
+    record.windowName = "window " + to_string(windowId);
+    record.mark = mark;
+    return record;
+}
+
+int main() {
+    size_t conflicts = 0;
+
+    // Marked and unmarked records of window 101 join through the con_id, window 102 joins
+    // through its mark although its con_id changed with an i3 restart.
+    Snapshot older = {makeRecord("eDP-1", "1", 101, windowMark(5001)), makeRecord("eDP-1", "1", 102, windowMark(5002))};
+    Snapshot newer = {makeRecord("HDMI-1", "2", 101), makeRecord("HDMI-1", "2", 202, windowMark(5002))};
+
+    Snapshot merged = mergeSnapshots({older, newer}, MERGE_LATEST, I3_ID, conflicts);
+    check(merged.size() == 2, "one record per window");
+    check(conflicts == 2, "both windows placed differently");
+    check(merged.size() == 2 && merged[0].workspaceName == "2", "newer record wins");
+    check(merged.size() == 2 && merged[0].mark == windowMark(5001), "mark kept for an unmarked newer record");
+    check(merged.size() == 2 && merged[1].windowId == 202, "joined by mark");
+
+    // Differently marked windows stay apart even when their con_ids collide.
+    Snapshot other = {makeRecord("eDP-1", "3", 101, windowMark(5009))};
+    merged = mergeSnapshots({older, other}, MERGE_LATEST, I3_ID, conflicts);
+    check(merged.size() == 3, "marks keep windows apart");
+
+    // Each output is owned by the newest snapshot with windows there: eDP-1 by the oldest,
+    // HDMI-1 by the newest.  The record from the middle one owns neither, so it loses.
+    Snapshot moved = {makeRecord("HDMI-1", "2", 102, windowMark(5002))};
+    Snapshot latest = {makeRecord("HDMI-1", "2", 300)};
+    merged = mergeSnapshots({older, moved, latest}, MERGE_OUTPUT_OWNER, I3_ID, conflicts);
+    check(merged.size() == 3 && merged[1].outputName == "eDP-1", "output owner keeps its record");
+
+    merged = mergeSnapshots({older, moved, latest}, MERGE_LATEST, I3_ID, conflicts);
+    check(merged.size() == 3 && merged[1].outputName == "HDMI-1", "latest record wins");
+
+    // A merged snapshot reads back as written.
+    merged = mergeSnapshots({older, newer}, MERGE_LATEST, I3_ID, conflicts);
+    for (bool encodeStrings : {true, false}) {
+        stringstream buffer;
+        writeSnapshot(buffer, merged, encodeStrings);
+        Snapshot read = readSnapshot(buffer);
+
+        bool same = read.size() == merged.size();
+        for (size_t i = 0; same && i < read.size(); i++)
+            same = read[i].outputName == merged[i].outputName && read[i].workspaceName == merged[i].workspaceName &&
+                   read[i].windowId == merged[i].windowId && read[i].mark == merged[i].mark;
+        check(same, encodeStrings ? "encoded merge round trip" : "raw merge round trip");
+    }
+
+    if (failures == 0) printf("merge_test: ok\n");
+    return failures == 0 ? 0 : 1;
+}
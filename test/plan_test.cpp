@@ -0,0 +1,129 @@
+/*
+ * Restore plans for scratchpad windows: one step and one command per window, split
+ * into batches like any other steps.  Replies to batched commands count every command.
+ *
+ * Usage: plan_test
+ */
+
+#include <cstdio>
+
+#include "ipc_command.h"
+#include "plan.h"
+#include "prefetch.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool passed, const char *what) {
+    if (passed) return;
+    fprintf(stderr, "FAIL: %s\n", what);
+    failures++;
+}
+
+static shared_ptr<i3ipc::container_t> makeCon(uint64_t id, const string &type, const string &name,
+                                              uint64_t xwindow = 0) {
+    auto c = make_shared<i3ipc::container_t>();
+    c->id = id;
+    c->xwindow_id = xwindow;
+    c->type = type;
+    c->name = name;
+    return c;
+}
+
+/**
+ * Live state with the given number of windows on hidden workspace 1 of eDP-1, and one
+ * window already in the scratchpad.
+ */
+static LiveState makeState(size_t windows) {
+    LiveState state;
+    state.tree = makeCon(1, "root", "root");
+
+    auto internal = makeCon(2, "output", "__i3");
+    auto scratch = makeCon(3, "workspace", SCRATCHPAD_WORKSPACE);
+    scratch->floating_nodes.push_back(makeCon(90, "con", "stashed", 0x900));
+    internal->nodes.push_back(scratch);
+    state.tree->nodes.push_back(internal);
+
+    auto output = makeCon(4, "output", "eDP-1");
+    auto workspace = makeCon(5, "workspace", "1");
+    for (size_t i = 0; i < windows; i++) workspace->nodes.push_back(makeCon(100 + i, "con", "window", 0x1000 + i));
+    output->nodes.push_back(workspace);
+    state.tree->nodes.push_back(output);
+
+    auto visible = make_shared<i3ipc::workspace_t>();
+    visible->num = 2;
+    visible->name = "2";
+    visible->visible = true;
+    visible->focused = true;
+    state.workspaces.push_back(visible);
+
+    auto hidden = make_shared<i3ipc::workspace_t>();
+    hidden->num = 1;
+    hidden->name = "1";
+    state.workspaces.push_back(hidden);
+
+    auto active = make_shared<i3ipc::output_t>();
+    active->name = "eDP-1";
+    active->active = true;
+    state.outputs.push_back(active);
+
+    return state;
+}
+
+static WindowRecord scratchpadRecord(size_t windowId) {
+    WindowRecord record;
+    record.outputName = "eDP-1";
+    record.workspaceName = "1";
+    record.workspaceId = 5;
+    record.windowId = windowId;
+    record.windowName = "window";
+    record.placement = PLACEMENT_SCRATCHPAD;
+    return record;
+}
+
+int main() {
+    CommandLineOptions opts = defaultOptions();
+    opts.windowIdentifier = I3_ID;
+
+    Snapshot snapshot = {scratchpadRecord(100), scratchpadRecord(101), scratchpadRecord(90)};
+    RestorePlan plan = planRestore(makeState(2), snapshot, opts);
+
+    check(plan.inPlace == 1, "window in the scratchpad is in place");
+    check(plan.commandCount() == 2, "one command per window");
+    check(plan.batches.size() == 1, "steps share a batch");
+
+    size_t steps = 0;
+    for (auto &batch : plan.batches) {
+        for (auto &step : batch.steps) {
+            steps++;
+            check(step.kind == MOVE_SCRATCHPAD, "scratchpad step kind");
+            check(step.command.find(';') == string::npos, "step holds a single command");
+        }
+    }
+    check(steps == 2, "one step per window");
+
+    // More scratchpad windows than fit one batch are split like other steps.
+    size_t windows = MAX_BATCH_COMMANDS + 1;
+    snapshot.clear();
+    for (size_t i = 0; i < windows; i++) snapshot.push_back(scratchpadRecord(100 + i));
+    plan = planRestore(makeState(windows), snapshot, opts);
+
+    check(plan.commandCount() == windows, "all windows planned");
+    check(plan.batches.size() == 2, "batch command limit applies");
+    for (auto &batch : plan.batches) check(batch.steps.size() <= MAX_BATCH_COMMANDS, "batch within limit");
+
+    // A batch reply holds one entry per command, failures anywhere in it.
+    auto results = parseCommandReply(R"([{"success":true},{"success":false,"error":"No window matches \"[x]\""},)"
+                                     R"( {"success": true, "input": "{\"success\":false}"}])");
+    check(results.size() == 3, "one result per command");
+    check(results.size() == 3 && results[0].success && !results[1].success && results[2].success,
+          "each command's success");
+    check(results.size() == 3 && results[1].error == "No window matches \"[x]\"", "error message unescaped");
+
+    results = parseCommandReply(R"([{"success":false,"parse_error":true,"error":"Expected one of these tokens"}])");
+    check(results.size() == 1 && !results[0].success, "parse error stops the batch");
+
+    if (failures == 0) printf("plan_test: ok\n");
+    return failures == 0 ? 0 : 1;
+}
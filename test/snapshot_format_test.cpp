@@ -0,0 +1,79 @@
+/*
+ * Round trip of snapshot records through both line formats, including names holding
+ * the characters the raw format escapes.
+ *
+ * Usage: snapshot_format_test
+ */
+
+#include <cstdio>
+#include <sstream>
+
+#include "snapshot.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool passed, const char *what) {
+    if (passed) return;
+    fprintf(stderr, "FAIL: %s\n", what);
+    failures++;
+}
+
+static WindowRecord makeRecord(const string &workspaceName, size_t windowId, const string &windowName,
+                               WindowPlacement placement, const string &mark) {
+    WindowRecord record;
+    record.outputName = "eDP-1";
+    record.workspaceName = workspaceName;
+    record.workspaceId = 94000000000000 + windowId;
+    record.windowId = windowId;
+    record.windowName = windowName;
+    record.placement = placement;
+    record.mark = mark;
+    return record;
+}
+
+static bool sameRecord(const WindowRecord &a, const WindowRecord &b) {
+    return a.outputName == b.outputName && a.workspaceName == b.workspaceName && a.workspaceId == b.workspaceId &&
+           a.windowId == b.windowId && a.windowName == b.windowName && a.placement == b.placement &&
+           a.mark == b.mark;
+}
+
+static Snapshot roundTrip(const Snapshot &snapshot, bool encodeStrings) {
+    stringstream buffer;
+    writeSnapshot(buffer, snapshot, encodeStrings);
+    return readSnapshot(buffer);
+}
+
+int main() {
+    Snapshot snapshot = {
+            makeRecord("1", 101, "plain title", PLACEMENT_TILING, ""),
+            makeRecord(" 2 <span foreground='#2aa198'>\xef\x84\xa0</span> ", 102, "tab\there", PLACEMENT_FLOATING,
+                       windowMark(0x1400001)),
+            makeRecord("3: web", 103, "back\\slash and\nnewline", PLACEMENT_SCRATCHPAD, ""),
+            makeRecord("4", 104, "", PLACEMENT_TILING, windowMark(0x1400002)),
+            makeRecord("5", 105, "placement=floating", PLACEMENT_TILING, ""),
+    };
+
+    for (bool encodeStrings : {true, false}) {
+        Snapshot read = roundTrip(snapshot, encodeStrings);
+        check(read.size() == snapshot.size(), encodeStrings ? "encoded record count" : "raw record count");
+
+        for (size_t i = 0; i < read.size() && i < snapshot.size(); i++)
+            check(sameRecord(read[i], snapshot[i]), encodeStrings ? "encoded record" : "raw record");
+    }
+
+    // Written raw, a record is one line with tab separated fields.
+    stringstream raw;
+    writeSnapshot(raw, Snapshot{snapshot[2]}, false);
+    string line = raw.str();
+    check(line.find('\n') == line.size() - 1, "raw record on one line");
+    check(line.find('\t') != string::npos, "raw fields separated by tabs");
+
+    // Blank lines between records are skipped.
+    stringstream blanks("\n" + line + " \t\n\n" + line);
+    check(readSnapshot(blanks).size() == 2, "blank lines skipped");
+
+    if (failures == 0) printf("snapshot_format_test: ok\n");
+    return failures == 0 ? 0 : 1;
+}